@@ -0,0 +1,39 @@
+#ifndef BENCH_HELPERS_HPP
+#define BENCH_HELPERS_HPP
+#include <lua.hpp>
+#include <string>
+
+inline std::string construct_bench_script_path(std::string script_name)
+{
+    const std::string lua_extension = ".lua";
+    bool has_no_extension = script_name.find(lua_extension) == std::string::npos;
+    if (has_no_extension) {
+        script_name += lua_extension;
+    }
+    auto project_folder = LUABZ_PROJECT_FOLDER_PATH;
+    const std::string script_folder = "/benchmarks/scripts/";
+    return project_folder + script_folder + script_name;
+}
+
+/**
+ * \brief Creates a lua state running the benchmark script through the raw C API,
+ * used as baseline by every benchmark
+ */
+inline lua_State* open_raw_bench_state(const std::string& script_name)
+{
+    lua_State* state = luaL_newstate();
+    luaL_dofile(state, construct_bench_script_path(script_name).c_str());
+    return state;
+}
+
+/// Pushes to the top of the stack the leaf table of the ten levels deep nested table
+inline void push_raw_nested_table(lua_State* state)
+{
+    lua_getglobal(state, "l1");
+    static const char* const levels[] = {"l2", "l3", "l4", "l5", "l6", "l7", "l8", "l9", "l10"};
+    for (const char* level : levels) {
+        lua_getfield(state, -1, level);
+        lua_remove(state, -2);
+    }
+}
+#endif
@@ -0,0 +1,195 @@
+#include "bench_helpers.hpp"
+#include "luabz.hpp"
+#include <benchmark/benchmark.h>
+#include <functional>
+#include <future>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+const std::string bench_script = "luabz_bench.lua";
+
+int free_function(int value)
+{
+    return value + 1;
+}
+
+struct member_holder {
+    int member_function(int value) { return value + 1; }
+};
+
+int raw_cpp_function(lua_State* state)
+{
+    lua_pushinteger(state, lua_tointeger(state, 1) + 1);
+    return 1;
+}
+
+/// Calls the registered C++ function through lua, so the whole trampoline is measured
+template <typename Register>
+void call_registered(benchmark::State& st, Register&& register_function)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    register_function(script);
+    int value = 0;
+    for (auto _ : st) {
+        value = std::get<0>(script["cpp_function"].call<int>(value));
+        benchmark::DoNotOptimize(value);
+    }
+    script.close();
+}
+}  // namespace
+
+static void BM_CallOperator_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    int value = 0;
+    for (auto _ : st) {
+        int result = script["identity"](value);
+        benchmark::DoNotOptimize(result);
+    }
+    script.close();
+}
+BENCHMARK(BM_CallOperator_var_ref);
+
+static void BM_Call_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    int value = 0;
+    for (auto _ : st) {
+        auto result = script["identity"].call<int>(value);
+        benchmark::DoNotOptimize(result);
+    }
+    script.close();
+}
+BENCHMARK(BM_Call_var_ref);
+
+static void BM_Call_async_script(benchmark::State& st)
+{
+    luabz::async_script script{construct_bench_script_path(bench_script)};
+    std::vector<std::future<int>> results;
+    const auto batch_size = static_cast<std::size_t>(st.range(0));
+    results.reserve(batch_size);
+    for (auto _ : st) {
+        for (std::size_t i = 0; i < batch_size; ++i) {
+            results.push_back(script.call<int>("identity", 0));
+        }
+        for (auto& result : results) {
+            benchmark::DoNotOptimize(result.get());
+        }
+        results.clear();
+    }
+    st.SetItemsProcessed(st.iterations() * st.range(0));
+}
+BENCHMARK(BM_Call_async_script)->Arg(1)->Arg(64);
+
+static void BM_Call_raw(benchmark::State& st)
+{
+    lua_State* state = open_raw_bench_state(bench_script);
+    int value = 0;
+    for (auto _ : st) {
+        lua_getglobal(state, "identity");
+        lua_pushinteger(state, value);
+        lua_pcall(state, 1, 1, 0);
+        auto result = lua_tointeger(state, -1);
+        lua_pop(state, 1);
+        benchmark::DoNotOptimize(result);
+    }
+    lua_close(state);
+}
+BENCHMARK(BM_Call_raw);
+
+static void BM_CallTwoArguments_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    for (auto _ : st) {
+        auto result = script["add"].call<int>(1, 2);
+        benchmark::DoNotOptimize(result);
+    }
+    script.close();
+}
+BENCHMARK(BM_CallTwoArguments_var_ref);
+
+static void BM_AssignLambda_var_ref(benchmark::State& st)
+{
+    call_registered(st, [](luabz::script& script) {
+        script["cpp_function"].assign([](int value) { return value + 1; });
+    });
+}
+BENCHMARK(BM_AssignLambda_var_ref);
+
+static void BM_AssignStdFunction_var_ref(benchmark::State& st)
+{
+    call_registered(st, [](luabz::script& script) {
+        std::function<int(int)> f = [](int value) { return value + 1; };
+        script["cpp_function"].assign(f);
+    });
+}
+BENCHMARK(BM_AssignStdFunction_var_ref);
+
+static void BM_AssignFreeFunction_var_ref(benchmark::State& st)
+{
+    call_registered(st,
+                    [](luabz::script& script) { script["cpp_function"].assign(free_function); });
+}
+BENCHMARK(BM_AssignFreeFunction_var_ref);
+
+static void BM_AssignMemberFunction_var_ref(benchmark::State& st)
+{
+    member_holder holder;
+    call_registered(st, [&holder](luabz::script& script) {
+        script["cpp_function"].assign(&holder, &member_holder::member_function);
+    });
+}
+BENCHMARK(BM_AssignMemberFunction_var_ref);
+
+static void BM_AssignOverloads_var_ref(benchmark::State& st)
+{
+    call_registered(st, [](luabz::script& script) {
+        script["cpp_function"].assign([](const std::string& value) { return value.size(); },
+                                      [](bool value) { return value ? 1 : 0; },
+                                      [](int value) { return value + 1; });
+    });
+}
+BENCHMARK(BM_AssignOverloads_var_ref);
+
+static void BM_CFunction_raw(benchmark::State& st)
+{
+    lua_State* state = open_raw_bench_state(bench_script);
+    lua_register(state, "cpp_function", raw_cpp_function);
+    int value = 0;
+    for (auto _ : st) {
+        lua_getglobal(state, "cpp_function");
+        lua_pushinteger(state, value);
+        lua_pcall(state, 1, 1, 0);
+        value = static_cast<int>(lua_tointeger(state, -1));
+        lua_pop(state, 1);
+        benchmark::DoNotOptimize(value);
+    }
+    lua_close(state);
+}
+BENCHMARK(BM_CFunction_raw);
+
+static void BM_EventDispatch_event_dispatcher(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    script("function on_events(events) end function on_event(event) end");
+    const auto mode = st.range(0) == 0 ? luabz::dispatch_mode::batch
+                                       : luabz::dispatch_mode::per_event;
+    luabz::mpsc_queue<int> queue{1024};
+    {
+        luabz::event_dispatcher<int> dispatcher{
+            script, mode == luabz::dispatch_mode::batch ? "on_events" : "on_event", queue, mode,
+            256};
+        for (auto _ : st) {
+            for (int i = 0; i < 256; ++i) {
+                queue.try_push(i);
+            }
+            dispatcher.drain();
+        }
+    }
+    st.SetItemsProcessed(st.iterations() * 256);
+    script.close();
+}
+BENCHMARK(BM_EventDispatch_event_dispatcher)->Arg(0)->Arg(1);
@@ -0,0 +1,63 @@
+#include "bench_helpers.hpp"
+#include "luabz.hpp"
+#include <benchmark/benchmark.h>
+#include <string>
+#include <tuple>
+
+// Numeric workloads, run the suite with USE_LUAJIT=ON and OFF to compare the interpreters
+namespace
+{
+const std::string bench_script = "luabz_bench.lua";
+
+constexpr int array_size = 1024;
+}  // namespace
+
+static void BM_LuaNumericLoop(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    for (auto _ : st) {
+        auto result = script["sum_to"].call<double>(static_cast<int>(st.range(0)));
+        benchmark::DoNotOptimize(result);
+    }
+    script.close();
+}
+BENCHMARK(BM_LuaNumericLoop)->Arg(1000)->Arg(100000);
+
+static void BM_SumArray_table(benchmark::State& st)
+{
+    lua_State* state = open_raw_bench_state(bench_script);
+    luaL_openlibs(state);
+    lua_getglobal(state, "fill_arrays");
+    lua_pushinteger(state, array_size);
+    lua_pcall(state, 1, 0, 0);
+    lua_getglobal(state, "numbers");
+    for (auto _ : st) {
+        double sum = 0.0;
+        for (int i = 1; i <= array_size; ++i) {
+            lua_rawgeti(state, -1, i);
+            sum += lua_tonumber(state, -1);
+            lua_pop(state, 1);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    lua_close(state);
+}
+BENCHMARK(BM_SumArray_table);
+
+#if defined(LUABZ_LUAJIT) && LUAJIT_VERSION_NUM >= 20100
+static void BM_SumArray_cdata(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script), true};
+    script["fill_arrays"].call<>(array_size);
+    for (auto _ : st) {
+        luabz::cdata<double> numbers = script["numbers_cdata"];
+        double sum = 0.0;
+        for (int i = 0; i < array_size; ++i) {
+            sum += numbers[static_cast<std::size_t>(i)];
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    script.close();
+}
+BENCHMARK(BM_SumArray_cdata);
+#endif
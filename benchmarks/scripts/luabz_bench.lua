@@ -0,0 +1,43 @@
+--Benchmark data
+counter=0;
+number=1.5;
+text="The quick brown fox jumps over the lazy dog";
+
+l1={l2={l3={l4={l5={l6={l7={l8={l9={l10={
+    counter=0
+}}}}}}}}}};
+
+function identity(value)
+    return value;
+end
+
+function add(a,b)
+    return a+b;
+end
+
+function call_cpp(value)
+    return cpp_function(value);
+end
+
+function sum_to(n)
+    local sum = 0;
+    for i = 1, n do
+        sum = sum + i * 0.5;
+    end
+    return sum;
+end
+
+-- Requires the standard library, numbers_cdata is created only on LuaJIT
+function fill_arrays(n)
+    numbers = {};
+    for i = 1, n do
+        numbers[i] = i * 0.5;
+    end
+    if jit then
+        local ffi = require("ffi");
+        numbers_cdata = ffi.new("double[?]", n);
+        for i = 0, n - 1 do
+            numbers_cdata[i] = numbers[i + 1];
+        end
+    end
+end
@@ -0,0 +1,177 @@
+#include "bench_helpers.hpp"
+#include "luabz.hpp"
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace
+{
+const std::string bench_script = "luabz_bench.lua";
+}  // namespace
+
+static void BM_StateCreation_script(benchmark::State& st)
+{
+    const std::string path = construct_bench_script_path(bench_script);
+    for (auto _ : st) {
+        luabz::script script{path};
+        script.close();
+    }
+}
+BENCHMARK(BM_StateCreation_script);
+
+static void BM_StateCreationWithStd_script(benchmark::State& st)
+{
+    const std::string path = construct_bench_script_path(bench_script);
+    for (auto _ : st) {
+        luabz::script script{path, true};
+        script.close();
+    }
+}
+BENCHMARK(BM_StateCreationWithStd_script);
+
+static void BM_StateCreation_raw(benchmark::State& st)
+{
+    const std::string path = construct_bench_script_path(bench_script);
+    for (auto _ : st) {
+        lua_State* state = luaL_newstate();
+        luaL_dofile(state, path.c_str());
+        lua_close(state);
+    }
+}
+BENCHMARK(BM_StateCreation_raw);
+
+static void BM_StateCreationWithStd_raw(benchmark::State& st)
+{
+    const std::string path = construct_bench_script_path(bench_script);
+    for (auto _ : st) {
+        lua_State* state = luaL_newstate();
+        luaL_dofile(state, path.c_str());
+        luaL_openlibs(state);
+        lua_close(state);
+    }
+}
+BENCHMARK(BM_StateCreationWithStd_raw);
+
+static void BM_StateClone_script(benchmark::State& st)
+{
+    luabz::script warmed_up{construct_bench_script_path(bench_script), luabz::unique_state, true};
+    for (auto _ : st) {
+        auto clone = warmed_up.clone();
+        clone.close();
+    }
+    warmed_up.close();
+}
+BENCHMARK(BM_StateClone_script);
+
+static void BM_IsolatedExecution_environment(benchmark::State& st)
+{
+    luabz::script shared{construct_bench_script_path(bench_script), luabz::unique_state, true};
+    for (auto _ : st) {
+        auto env = shared.acquire_environment();
+        shared("tenant = 1", env);
+    }
+    shared.close();
+}
+BENCHMARK(BM_IsolatedExecution_environment);
+
+static void BM_StateCreationFromModule_script(benchmark::State& st)
+{
+    luabz::module_registry::add_file("luabz_bench", construct_bench_script_path(bench_script));
+    const std::string module_name = luabz::from_module("luabz_bench");
+    for (auto _ : st) {
+        luabz::script script{module_name};
+        script.close();
+    }
+    luabz::module_registry::remove("luabz_bench");
+}
+BENCHMARK(BM_StateCreationFromModule_script);
+
+static void BM_StateCreationPreloaded_script(benchmark::State& st)
+{
+    const std::string path = construct_bench_script_path(bench_script);
+    luabz::state::preload({path}, 1);
+    for (auto _ : st) {
+        luabz::script script{path};
+        script.close();
+    }
+    luabz::state::discard_preloaded();
+}
+BENCHMARK(BM_StateCreationPreloaded_script);
+
+/// Allocates garbage as a request would, then collects it in a 200us idle gap
+static void BM_IdleCollection_garbage_collector(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script), luabz::unique_state};
+    luabz::garbage_collector gc = script.gc();
+    gc.stop();
+    for (auto _ : st) {
+        script("for i = 1, 1000 do local t = {i, i} end");
+        benchmark::DoNotOptimize(gc.step_for(std::chrono::microseconds{200}));
+    }
+    st.counters["memory_kb"] = static_cast<double>(gc.memory()) / 1024.0;
+    script.close();
+}
+BENCHMARK(BM_IdleCollection_garbage_collector);
+
+namespace
+{
+/// Lua script of about 100 MB, of the kind of the generated data scripts, removed on destruction
+class large_script_file
+{
+  public:
+    large_script_file() : m_path{std::string(P_tmpdir) + "/luabz_bench_large.lua"}
+    {
+        std::ofstream file{m_path, std::ios::trunc};
+        file << "data = {}\n";
+        const std::string row = "data[#data + 1] = {id = 1, price = 2.5, name = \"abcdefgh\"}\n";
+        for (std::size_t written = 0; written < 100 * 1024 * 1024; written += row.size()) {
+            file << row;
+        }
+    }
+
+    large_script_file(const large_script_file&) = delete;
+
+    large_script_file& operator=(const large_script_file&) = delete;
+
+    ~large_script_file() { std::remove(m_path.c_str()); }
+
+    const std::string& path() const { return m_path; }
+
+  private:
+    std::string m_path;
+};
+
+/// Generates the large script once, it's removed when the benchmarks exit
+const std::string& large_script_path()
+{
+    static const large_script_file file{};
+    return file.path();
+}
+}  // namespace
+
+static void BM_LoadLargeScript_loadfile(benchmark::State& st)
+{
+    lua_State* state = luaL_newstate();
+    const std::string& path = large_script_path();
+    for (auto _ : st) {
+        luaL_loadfile(state, path.c_str());
+        lua_settop(state, 0);
+    }
+    lua_close(state);
+}
+BENCHMARK(BM_LoadLargeScript_loadfile)->Unit(benchmark::kMillisecond)->Iterations(5);
+
+static void BM_LoadLargeScript_mmap(benchmark::State& st)
+{
+    lua_State* state = luaL_newstate();
+    const std::string& path = large_script_path();
+    for (auto _ : st) {
+        luabz::load_file(state, path);
+        lua_settop(state, 0);
+    }
+    lua_close(state);
+}
+BENCHMARK(BM_LoadLargeScript_mmap)->Unit(benchmark::kMillisecond)->Iterations(5);
@@ -0,0 +1,330 @@
+#include "bench_helpers.hpp"
+#include "luabz.hpp"
+#include <benchmark/benchmark.h>
+#include <string>
+
+namespace
+{
+const std::string bench_script = "luabz_bench.lua";
+
+luabz::var_ref nested_counter(const luabz::script& script)
+{
+    return script["l1"]["l2"]["l3"]["l4"]["l5"]["l6"]["l7"]["l8"]["l9"]["l10"]["counter"];
+}
+}  // namespace
+
+static void BM_GlobalGet_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    for (auto _ : st) {
+        int counter = script["counter"];
+        benchmark::DoNotOptimize(counter);
+    }
+    script.close();
+}
+BENCHMARK(BM_GlobalGet_var_ref);
+
+// Same as BM_GlobalGet_var_ref with the raw lua_to* accessors instead of luaL_check*
+static void BM_GlobalGet_var_ref_unchecked(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    for (auto _ : st) {
+        auto counter = script["counter"].get<int, luabz::unchecked>();
+        benchmark::DoNotOptimize(counter);
+    }
+    script.close();
+}
+BENCHMARK(BM_GlobalGet_var_ref_unchecked);
+
+static void BM_NumberGet_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    for (auto _ : st) {
+        auto number = script["number"].get<double>();
+        benchmark::DoNotOptimize(number);
+    }
+    script.close();
+}
+BENCHMARK(BM_NumberGet_var_ref);
+
+static void BM_NumberGet_var_ref_unchecked(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    for (auto _ : st) {
+        auto number = script["number"].get<double, luabz::unchecked>();
+        benchmark::DoNotOptimize(number);
+    }
+    script.close();
+}
+BENCHMARK(BM_NumberGet_var_ref_unchecked);
+
+static void BM_StringGet_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    for (auto _ : st) {
+        auto text = script["text"].get<std::string>();
+        benchmark::DoNotOptimize(text);
+    }
+    script.close();
+}
+BENCHMARK(BM_StringGet_var_ref);
+
+static void BM_StringGet_var_ref_unchecked(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    for (auto _ : st) {
+        auto text = script["text"].get<std::string, luabz::unchecked>();
+        benchmark::DoNotOptimize(text);
+    }
+    script.close();
+}
+BENCHMARK(BM_StringGet_var_ref_unchecked);
+
+static void BM_GlobalGet_raw(benchmark::State& st)
+{
+    lua_State* state = open_raw_bench_state(bench_script);
+    for (auto _ : st) {
+        lua_getglobal(state, "counter");
+        auto counter = lua_tointeger(state, -1);
+        lua_pop(state, 1);
+        benchmark::DoNotOptimize(counter);
+    }
+    lua_close(state);
+}
+BENCHMARK(BM_GlobalGet_raw);
+
+static void BM_GlobalSet_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    int counter = 0;
+    for (auto _ : st) {
+        script["counter"] = ++counter;
+    }
+    script.close();
+}
+BENCHMARK(BM_GlobalSet_var_ref);
+
+static void BM_GlobalSet_raw(benchmark::State& st)
+{
+    lua_State* state = open_raw_bench_state(bench_script);
+    int counter = 0;
+    for (auto _ : st) {
+        lua_pushinteger(state, ++counter);
+        lua_setglobal(state, "counter");
+    }
+    lua_close(state);
+}
+BENCHMARK(BM_GlobalSet_raw);
+
+static void BM_NestedGet_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    auto counter_ref = nested_counter(script);
+    for (auto _ : st) {
+        int counter = counter_ref;
+        benchmark::DoNotOptimize(counter);
+    }
+    script.close();
+}
+BENCHMARK(BM_NestedGet_var_ref);
+
+static void BM_NestedGet_var_ref_unchecked(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    auto counter_ref = nested_counter(script);
+    for (auto _ : st) {
+        auto counter = counter_ref.get<int, luabz::unchecked>();
+        benchmark::DoNotOptimize(counter);
+    }
+    script.close();
+}
+BENCHMARK(BM_NestedGet_var_ref_unchecked);
+
+static void BM_NestedGet_var_ref_path(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    for (auto _ : st) {
+        int counter = nested_counter(script);
+        benchmark::DoNotOptimize(counter);
+    }
+    script.close();
+}
+BENCHMARK(BM_NestedGet_var_ref_path);
+
+static void BM_NestedGet_raw(benchmark::State& st)
+{
+    lua_State* state = open_raw_bench_state(bench_script);
+    for (auto _ : st) {
+        push_raw_nested_table(state);
+        lua_getfield(state, -1, "counter");
+        auto counter = lua_tointeger(state, -1);
+        lua_pop(state, 2);
+        benchmark::DoNotOptimize(counter);
+    }
+    lua_close(state);
+}
+BENCHMARK(BM_NestedGet_raw);
+
+static void BM_NestedSet_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    auto counter_ref = nested_counter(script);
+    int counter = 0;
+    for (auto _ : st) {
+        counter_ref = ++counter;
+    }
+    script.close();
+}
+BENCHMARK(BM_NestedSet_var_ref);
+
+static void BM_NestedSet_raw(benchmark::State& st)
+{
+    lua_State* state = open_raw_bench_state(bench_script);
+    int counter = 0;
+    for (auto _ : st) {
+        push_raw_nested_table(state);
+        lua_pushinteger(state, ++counter);
+        lua_setfield(state, -2, "counter");
+        lua_pop(state, 1);
+    }
+    lua_close(state);
+}
+BENCHMARK(BM_NestedSet_raw);
+
+static void BM_NestedCompoundAssignment_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    auto counter_ref = nested_counter(script);
+    for (auto _ : st) {
+        counter_ref += 1;
+    }
+    script.close();
+}
+BENCHMARK(BM_NestedCompoundAssignment_var_ref);
+
+/// Read and write done through two separate walks, how compound assignment used to work
+static void BM_NestedReadThenWrite_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    auto counter_ref = nested_counter(script);
+    for (auto _ : st) {
+        int counter = counter_ref;
+        counter_ref = counter + 1;
+    }
+    script.close();
+}
+BENCHMARK(BM_NestedReadThenWrite_var_ref);
+
+static void BM_NestedCompoundAssignment_raw(benchmark::State& st)
+{
+    lua_State* state = open_raw_bench_state(bench_script);
+    for (auto _ : st) {
+        push_raw_nested_table(state);
+        lua_getfield(state, -1, "counter");
+        auto counter = lua_tointeger(state, -1);
+        lua_pop(state, 1);
+        lua_pushinteger(state, counter + 1);
+        lua_setfield(state, -2, "counter");
+        lua_pop(state, 1);
+    }
+    lua_close(state);
+}
+BENCHMARK(BM_NestedCompoundAssignment_raw);
+
+static void BM_StringRoundTrip_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    for (auto _ : st) {
+        std::string text = script["text"];
+        script["text"] = text;
+        benchmark::DoNotOptimize(text);
+    }
+    script.close();
+}
+BENCHMARK(BM_StringRoundTrip_var_ref);
+
+static void BM_StringRoundTrip_raw(benchmark::State& st)
+{
+    lua_State* state = open_raw_bench_state(bench_script);
+    for (auto _ : st) {
+        lua_getglobal(state, "text");
+        std::size_t length = 0;
+        const char* data = lua_tolstring(state, -1, &length);
+        std::string text(data, length);
+        lua_pop(state, 1);
+        lua_pushlstring(state, text.c_str(), text.size());
+        lua_setglobal(state, "text");
+        benchmark::DoNotOptimize(text);
+    }
+    lua_close(state);
+}
+BENCHMARK(BM_StringRoundTrip_raw);
+
+static void BM_CrossStateTableCopy_var_ref(benchmark::State& st)
+{
+    luabz::script source{construct_bench_script_path(bench_script)};
+    luabz::script target{construct_bench_script_path(bench_script), luabz::unique_state};
+    for (auto _ : st) {
+        target["l1"] = source["l1"];
+    }
+    target.close();
+    source.close();
+}
+BENCHMARK(BM_CrossStateTableCopy_var_ref);
+
+static void BM_TableTraversal_pairs(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    script("large = {} for i = 1, 100000 do large[i] = i end");
+    for (auto _ : st) {
+        long long sum = 0;
+        for (auto entry : script["large"].pairs()) {
+            sum += entry.value.get<long long, luabz::unchecked>();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    st.SetItemsProcessed(st.iterations() * 100000);
+    script.close();
+}
+BENCHMARK(BM_TableTraversal_pairs);
+
+static void BM_TableTraversal_paths(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    script("large = {} for i = 1, 100000 do large[i] = i end");
+    for (auto _ : st) {
+        long long sum = 0;
+        for (int i = 1; i <= 100000; ++i) {
+            sum += script["large." + std::to_string(i)].get<long long>();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    st.SetItemsProcessed(st.iterations() * 100000);
+    script.close();
+}
+BENCHMARK(BM_TableTraversal_paths);
+
+namespace
+{
+struct summing_visitor : luabz::table_visitor {
+    long long sum = 0;
+    void scalar(const luabz::stack_value& value)
+    {
+        sum += value.get<long long, luabz::unchecked>();
+    }
+};
+}  // namespace
+
+static void BM_NestedTableVisit_var_ref(benchmark::State& st)
+{
+    luabz::script script{construct_bench_script_path(bench_script)};
+    script("rows = {} for i = 1, 100000 do rows[i] = {id = i, count = 2} end");
+    for (auto _ : st) {
+        summing_visitor visitor;
+        script["rows"].visit(visitor);
+        benchmark::DoNotOptimize(visitor.sum);
+    }
+    st.SetItemsProcessed(st.iterations() * 100000);
+    script.close();
+}
+BENCHMARK(BM_NestedTableVisit_var_ref);
@@ -13,7 +13,7 @@ allert () { echo -e "${RED}$1${NC}"; }
 function run()
 {
     workingprocess "Running test"
-    ./$1
+    ./$1 "${@:2}"
     if [ $? -eq 0 ]; then
     workingprocess "All tests compile and pass."
     else
@@ -25,7 +25,8 @@ function run()
 # Building project
 mkdir -p build
 cd build
-cmake -DCMAKE_BUILD_TYPE=Debug -DENABLE_CLANG_TIDY=ON -DCMAKE_EXPORT_COMPILE_COMMANDS=ON  -DENABLE_CODE_COVERAGE=ON ..
+# LUA_VERSION selects the lua backend, e.g. LUA_VERSION=5.3 ./build.sh, USE_LUAJIT=ON builds against LuaJIT
+cmake -DCMAKE_BUILD_TYPE=Debug -DENABLE_CLANG_TIDY=ON -DCMAKE_EXPORT_COMPILE_COMMANDS=ON  -DENABLE_CODE_COVERAGE=ON -DLUABZ_LUA_VERSION=${LUA_VERSION:-5.1} -DUSE_LUAJIT=${USE_LUAJIT:-OFF} ..
 make -j8
 # Checks if last comand didn't output 0
 # $? checks what last command outputed
@@ -38,7 +39,8 @@ if [ $? -ne 0 ]; then
 fi
 cd ../bin
 run_tests luabz_tests
-run luabz
+# Short smoke run of the load generator, a real load test runs ./luabz without --duration
+run luabz --duration=0.1 --threads=1
 
 #Uncomment if you want to run cppcheck
 #workingprocess "Running cppcheck"
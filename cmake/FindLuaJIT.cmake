@@ -0,0 +1,35 @@
+#-----------------------------------------------------------
+#   Locates LuaJIT, either a system installation or a
+#   vendored one pointed to by LUAJIT_DIR
+#
+#   LUAJIT_FOUND          LuaJIT has been found
+#   LUAJIT_INCLUDE_DIR    Folder containing luajit.h and lua.hpp
+#   LUAJIT_LIBRARIES      Libraries to link against
+#   LUAJIT_VERSION_STRING Version from luajit.h
+#-----------------------------------------------------------
+find_path(LUAJIT_INCLUDE_DIR luajit.h
+          HINTS ${LUAJIT_DIR} ENV LUAJIT_DIR
+          PATH_SUFFIXES include/luajit-2.1 include/luajit-2.0 include src luajit-2.1 luajit-2.0
+          )
+find_library(LUAJIT_LIBRARY
+             NAMES luajit-5.1 luajit libluajit.a
+             HINTS ${LUAJIT_DIR} ENV LUAJIT_DIR
+             PATH_SUFFIXES lib src
+             )
+
+if(LUAJIT_INCLUDE_DIR AND EXISTS "${LUAJIT_INCLUDE_DIR}/luajit.h")
+    file(STRINGS "${LUAJIT_INCLUDE_DIR}/luajit.h" LUAJIT_VERSION_LINE
+         REGEX "^#define[ \t]+LUAJIT_VERSION[ \t]+\"LuaJIT .+\"")
+    string(REGEX REPLACE "^#define[ \t]+LUAJIT_VERSION[ \t]+\"LuaJIT ([^\"]+)\".*" "\\1"
+           LUAJIT_VERSION_STRING "${LUAJIT_VERSION_LINE}")
+endif()
+
+#The static library needs libdl and libm, harmless for the shared one
+set(LUAJIT_LIBRARIES ${LUAJIT_LIBRARY} ${CMAKE_DL_LIBS} m)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LuaJIT
+                                  REQUIRED_VARS LUAJIT_LIBRARY LUAJIT_INCLUDE_DIR
+                                  VERSION_VAR LUAJIT_VERSION_STRING
+                                  )
+mark_as_advanced(LUAJIT_INCLUDE_DIR LUAJIT_LIBRARY)
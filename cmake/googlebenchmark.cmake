@@ -0,0 +1,49 @@
+#-----------------------------
+#   Initial setup
+#-----------------------------
+find_package(Threads REQUIRED)
+include(ExternalProject)
+
+#----------------------------------------
+#   Download and build Google Benchmark
+#----------------------------------------
+ExternalProject_Add(
+    gbenchmark
+    URL https://github.com/google/benchmark/archive/main.zip
+    PREFIX ${CMAKE_CURRENT_BINARY_DIR}/gbenchmark
+    CMAKE_ARGS -DCMAKE_BUILD_TYPE=Release
+               -DBENCHMARK_ENABLE_TESTING=OFF
+               -DBENCHMARK_ENABLE_GTEST_TESTS=OFF
+    # Disable install step
+    INSTALL_COMMAND ""
+)
+
+#---------------------------------------------------
+#   Get Google Benchmark source and binary
+#   directories from CMake project
+#---------------------------------------------------
+ExternalProject_Get_Property(gbenchmark source_dir binary_dir)
+
+
+#--------------------------------------------
+#   Create a libbenchmark target to be used
+#   as a dependency by benchmark programs
+#---------------------------------------------
+add_library(libbenchmark IMPORTED STATIC GLOBAL)
+add_dependencies(libbenchmark gbenchmark)
+set_target_properties(libbenchmark PROPERTIES
+"IMPORTED_LOCATION" "${binary_dir}/src/libbenchmark.a"
+"IMPORTED_LINK_INTERFACE_LIBRARIES" "${CMAKE_THREAD_LIBS_INIT}"
+)
+
+add_library(libbenchmark_main IMPORTED STATIC GLOBAL)
+add_dependencies(libbenchmark_main gbenchmark)
+set_target_properties(libbenchmark_main PROPERTIES
+"IMPORTED_LOCATION" "${binary_dir}/src/libbenchmark_main.a"
+"IMPORTED_LINK_INTERFACE_LIBRARIES" "${CMAKE_THREAD_LIBS_INIT}"
+)
+
+#---------------------------------
+#   Add include directories
+#---------------------------------
+include_directories("${source_dir}/include")
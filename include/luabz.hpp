@@ -1,3 +1,8 @@
 #pragma once
+#include "luabz/async_script.hpp"
+#include "luabz/cdata.hpp"
+#include "luabz/event_queue.hpp"
+#include "luabz/fields.hpp"
+#include "luabz/profiler.hpp"
 #include "luabz/script.hpp"
 #include "luabz/var_ref.hpp"
\ No newline at end of file
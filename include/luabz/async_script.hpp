@@ -0,0 +1,179 @@
+#pragma once
+#include "script.hpp"
+#include "state.hpp"
+#include "var_ref.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace luabz
+{
+/**
+ * \brief Script owned by a dedicated worker thread, to which any thread
+ * submits calls without locking around the lua state
+ *
+ * Every request is queued and answered through a std::future. The worker
+ * takes the pending requests in batches of up to batch_size and runs a whole
+ * batch before looking at the queue again, so the queue lock is taken once per
+ * batch instead of once per request. Requests submitted by the same thread run
+ * in submission order. \n
+ * Errors raised by a request, e.g. a luabz_exception when the library is
+ * compiled with LUABZ_USE_CPP_EXCEPTIONS, are rethrown by the future.
+ * \note The lua state is touched only by the worker, a request must not let a
+ * var_ref or any other reference to the state escape
+ */
+class async_script
+{
+  public:
+    explicit async_script(const std::string& file,
+                          bool load_lua_std = false,
+                          std::size_t batch_size = 64)
+      : m_script{file, unique_state, load_lua_std},
+        m_batchSize{batch_size == 0 ? 1 : batch_size},
+        m_worker{[this] { run(); }}
+    {
+    }
+
+    async_script(const async_script&) = delete;
+
+    async_script& operator=(const async_script&) = delete;
+
+    /// Runs the pending requests, then closes the script
+    ~async_script()
+    {
+        stop();
+        m_script.close();
+    }
+
+    /**
+     * \brief Queues a call of the lua function name
+     * \return The future of its result, or of nothing when R is void
+     * \note The arguments are copied, as std::decay_t, into the request
+     */
+    template <typename R, typename... Args>
+    std::future<R> call(const std::string& name, Args&&... args)
+    {
+        auto arguments = std::make_tuple(std::forward<Args>(args)...);
+        return submit([name, arguments](script& target) mutable -> R {
+            var_ref function = target[name];
+            return invoke<R>(function, arguments, std::index_sequence_for<Args...>{});
+        });
+    }
+
+    /**
+     * \brief Queues a task receiving the script, for work which doesn't fit
+     * in a single call
+     */
+    template <typename F>
+    auto submit(F&& task) -> std::future<decltype(task(std::declval<script&>()))>
+    {
+        using result_type = decltype(task(std::declval<script&>()));
+        auto packaged =
+            std::make_shared<std::packaged_task<result_type(script&)>>(std::forward<F>(task));
+        auto result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping) {
+                // The dropped task breaks the promise of the future
+                return result;
+            }
+            bool was_empty = m_queue.empty();
+            m_queue.emplace_back([packaged](script& target) { (*packaged)(target); });
+            // The worker waits only on an empty queue
+            if (!was_empty) {
+                return result;
+            }
+        }
+        m_ready.notify_one();
+        return result;
+    }
+
+    /**
+     * \brief Runs the pending requests and stops the worker, the requests
+     * submitted afterwards are dropped
+     */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_ready.notify_one();
+        if (m_worker.joinable()) {
+            m_worker.join();
+        }
+    }
+
+    /// Number of requests waiting for the worker
+    std::size_t pending() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queue.size();
+    }
+
+  private:
+    using request = std::function<void(script&)>;
+
+    template <typename R, typename Tuple, std::size_t... I>
+    static typename std::enable_if<!std::is_void<R>::value, R>::type
+    invoke(var_ref& function, Tuple& arguments, std::index_sequence<I...> /*unused*/)
+    {
+        return std::get<0>(function.call<R>(std::get<I>(arguments)...));
+    }
+
+    template <typename R, typename Tuple, std::size_t... I>
+    static typename std::enable_if<std::is_void<R>::value>::type
+    invoke(var_ref& function, Tuple& arguments, std::index_sequence<I...> /*unused*/)
+    {
+        function.call<>(std::get<I>(arguments)...);
+    }
+
+    void run()
+    {
+        std::vector<request> batch;
+        batch.reserve(m_batchSize);
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_ready.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+                if (m_queue.empty()) {
+                    return;
+                }
+                while (!m_queue.empty() && batch.size() < m_batchSize) {
+                    batch.push_back(std::move(m_queue.front()));
+                    m_queue.pop_front();
+                }
+            }
+            for (auto& current : batch) {
+                current(m_script);
+            }
+            batch.clear();
+        }
+    }
+
+    script m_script;
+
+    std::size_t m_batchSize;
+
+    mutable std::mutex m_mutex{};
+
+    std::condition_variable m_ready{};
+
+    std::deque<request> m_queue{};
+
+    bool m_stopping = false;
+
+    /// Declared last, the worker starts once the other members are initialized
+    std::thread m_worker;
+};
+}  // namespace luabz
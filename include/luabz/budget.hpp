@@ -0,0 +1,184 @@
+#pragma once
+#include "interface.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <lua.hpp>
+
+namespace luabz
+{
+/**
+ * \brief Limits the execution of a lua call, by number of lua instructions
+ * and/or by a wall-clock deadline
+ */
+struct budget {
+    using clock_type = std::chrono::steady_clock;
+
+    /// Maximum number of lua instructions, 0 means unlimited
+    std::size_t instructions = 0;
+    /// Point in time after which the call is interrupted
+    clock_type::time_point deadline = clock_type::time_point::max();
+
+    static budget instructions_limit(std::size_t instructions_count)
+    {
+        budget result;
+        result.instructions = instructions_count;
+        return result;
+    }
+
+    static budget time_limit(clock_type::duration duration)
+    {
+        return deadline_at(clock_type::now() + duration);
+    }
+
+    static budget deadline_at(clock_type::time_point time_point)
+    {
+        budget result;
+        result.deadline = time_point;
+        return result;
+    }
+
+    bool has_instructions_limit() const { return instructions != 0; }
+
+    bool has_deadline() const { return deadline != clock_type::time_point::max(); }
+};
+
+/**
+ * \brief RAII helper enforcing a budget on the lua code executed while it's
+ * alive, through a count hook which raises a lua error when the budget is
+ * exceeded
+ * The instruction budget is exact, the hook count is lowered to the remaining
+ * instructions once they are fewer than deadline_check_interval. The deadline
+ * is checked every deadline_check_interval instructions.
+ * \note No hook is installed for an unlimited budget. While the guard is alive
+ * it replaces any other hook of the state, e.g. the one of a running profiler,
+ * which is restored when the guard is destroyed. LuaJIT doesn't run the hooks
+ * inside compiled traces, so its JIT compiler is turned off while the guard is
+ * alive, which flushes the compiled traces of the state.
+ */
+class budget_guard
+{
+  public:
+    /// Number of instructions between two checks of the deadline
+    static constexpr std::size_t deadline_check_interval = 1000;
+
+    budget_guard(lua_State* state, const budget& limit)
+      : m_state{state},
+        m_limit{limit},
+        m_active{limit.has_instructions_limit() || limit.has_deadline()}
+    {
+        if (!m_active) {
+            return;
+        }
+        m_previousHook = lua_gethook(m_state);
+        m_previousMask = lua_gethookmask(m_state);
+        m_previousCount = lua_gethookcount(m_state);
+        lua_pushlightuserdata(m_state, registry_key());
+        lua_rawget(m_state, LUA_REGISTRYINDEX);
+        m_previousGuard = lua_touserdata(m_state, -1);
+        lua_pop(m_state, 1);
+        set_active_guard(this);
+        m_jitWasEnabled = interface::suspend_jit(m_state);
+
+        std::size_t step = deadline_check_interval;
+        if (m_limit.has_instructions_limit()) {
+            step = std::min(step, m_limit.instructions);
+        }
+        m_step = static_cast<int>(step);
+        lua_sethook(m_state, &budget_guard::hook, LUA_MASKCOUNT, m_step);
+    }
+
+    budget_guard(const budget_guard&) = delete;
+
+    budget_guard& operator=(const budget_guard&) = delete;
+
+    ~budget_guard()
+    {
+        if (!m_active) {
+            return;
+        }
+        interface::resume_jit(m_state, m_jitWasEnabled);
+        lua_sethook(m_state, m_previousHook, m_previousMask, m_previousCount);
+        set_active_guard(m_previousGuard);
+    }
+
+    bool exceeded() const { return m_exceeded; }
+
+    /**
+     * \brief Checks whether the budget of the guard active on state has been
+     * exceeded, used to classify the error of a failed call
+     */
+    static bool is_exceeded(lua_State* state)
+    {
+        lua_pushlightuserdata(state, registry_key());
+        lua_rawget(state, LUA_REGISTRYINDEX);
+        auto* guard = static_cast<budget_guard*>(lua_touserdata(state, -1));
+        lua_pop(state, 1);
+        return guard != nullptr && guard->exceeded();
+    }
+
+  private:
+    /// Address used as the registry key of the active guard
+    static void* registry_key()
+    {
+        static char key = 0;
+        return &key;
+    }
+
+    void set_active_guard(void* guard)
+    {
+        lua_pushlightuserdata(m_state, registry_key());
+        if (guard != nullptr) {
+            lua_pushlightuserdata(m_state, guard);
+        } else {
+            lua_pushnil(m_state);
+        }
+        lua_rawset(m_state, LUA_REGISTRYINDEX);
+    }
+
+    static void hook(lua_State* state, lua_Debug* /*unused*/)
+    {
+        lua_pushlightuserdata(state, registry_key());
+        lua_rawget(state, LUA_REGISTRYINDEX);
+        auto* guard = static_cast<budget_guard*>(lua_touserdata(state, -1));
+        lua_pop(state, 1);
+        if (guard == nullptr) {
+            return;
+        }
+        guard->m_executed += static_cast<std::size_t>(guard->m_step);
+        const budget& limit = guard->m_limit;
+        if (limit.has_instructions_limit() && guard->m_executed >= limit.instructions) {
+            guard->m_exceeded = true;
+            // A buffer, luaL_error longjmps over the C++ objects and %llu isn't supported
+            char limit_text[32];
+            std::snprintf(limit_text, sizeof(limit_text), "%llu",
+                          static_cast<unsigned long long>(limit.instructions));
+            luaL_error(state, "instruction budget of %s exceeded", limit_text);
+        }
+        if (limit.has_deadline() && budget::clock_type::now() >= limit.deadline) {
+            guard->m_exceeded = true;
+            luaL_error(state, "deadline exceeded");
+        }
+        if (limit.has_instructions_limit()) {
+            std::size_t remaining = limit.instructions - guard->m_executed;
+            if (remaining < static_cast<std::size_t>(guard->m_step)) {
+                guard->m_step = static_cast<int>(remaining);
+                lua_sethook(state, &budget_guard::hook, LUA_MASKCOUNT, guard->m_step);
+            }
+        }
+    }
+
+    lua_State* m_state;
+    budget m_limit;
+    bool m_active;
+    bool m_exceeded = false;
+    int m_step = 0;
+    std::size_t m_executed = 0;
+    lua_Hook m_previousHook = nullptr;
+    int m_previousMask = 0;
+    int m_previousCount = 0;
+    void* m_previousGuard = nullptr;
+    bool m_jitWasEnabled = false;
+};
+}  // namespace luabz
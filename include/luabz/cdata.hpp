@@ -0,0 +1,71 @@
+#pragma once
+#include "error.hpp"
+#include "interface.hpp"
+#include "value.hpp"
+#include <cstddef>
+#include <lua.hpp>
+#include <type_traits>
+
+namespace luabz
+{
+/**
+ * \brief Non owning view of the memory of a LuaJIT FFI cdata, used to hand
+ * ffi arrays and structs to C++ without converting them element by element
+ * \note T is the element type of an array, e.g. cdata<double> for
+ * ffi.new("double[?]", n), or the struct itself for ffi.new("struct point").
+ * The memory is owned by lua, the view must not outlive the cdata. Pointer and
+ * reference cdata, e.g. ffi.cast("double *", p), are rejected: their memory
+ * holds the pointer, not the data it points to.
+ */
+template <typename T>
+struct cdata {
+    T* pointer = nullptr;
+
+    T& operator*() const { return *pointer; }
+
+    T* operator->() const { return pointer; }
+
+    T& operator[](std::size_t index) const { return pointer[index]; }
+
+    explicit operator bool() const { return pointer != nullptr; }
+};
+
+#if defined(LUABZ_LUAJIT) && LUAJIT_VERSION_NUM >= 20100
+template <typename T>
+struct value<cdata<T>> {
+    /**
+     * \brief Pushes the pointer as light userdata, lua code can use it through
+     * ffi.cast
+     */
+    static void insert(lua_State* state, cdata<T> data)
+    {
+        lua_pushlightuserdata(state, const_cast<void*>(static_cast<const void*>(data.pointer)));
+    }
+
+    static bool is(lua_State* state, int stack_index)
+    {
+        if (interface::is_cdata(state, stack_index)) {
+            return !interface::is_pointer_cdata(state, stack_index);
+        }
+        return lua_islightuserdata(state, stack_index);
+    }
+
+    /**
+     * \note With the unchecked policy the type of the value is not checked, a
+     * pointer cdata then gives a view of the pointer itself
+     */
+    template <typename Policy = checked>
+    static cdata<T> get(lua_State* state, int stack_index, Policy /*unused*/ = Policy{})
+    {
+        cdata<T> result;
+        if (std::is_same<Policy, checked>::value && !is(state, stack_index)) {
+            error("The lua variable is neither a non pointer cdata nor a light userdata",
+                  error_kind::type_mismatch);
+            return result;
+        }
+        result.pointer = static_cast<T*>(interface::get_cdata(state, stack_index));
+        return result;
+    }
+};
+#endif
+}  // namespace luabz
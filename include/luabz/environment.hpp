@@ -0,0 +1,225 @@
+#pragma once
+#include "interface.hpp"
+#include "state_lifetime.hpp"
+#include <lua.hpp>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace luabz
+{
+/**
+ * \brief Handle of an environment table, in which lua code runs isolated from
+ * the other executions hosted by the same lua state
+ *
+ * Globals read by the code fall back, through __index, to the globals of the
+ * state, which act as a shared read-only base. Globals assigned by the code
+ * are stored in the environment table, so the base and the other environments
+ * never see them. \n
+ * The tables are recycled: when the handle is released the table is cleared
+ * and returned to the pool of its state, to be handed out by the next acquire,
+ * so an isolated execution costs a table swap instead of a new lua_State.
+ * \note Only the assignments to globals are isolated, the tables of the base,
+ * e.g. string, are shared and their fields can still be modified. Handles
+ * outliving their lua state, once script::close removes it, are emptied and
+ * never touch the closed state.
+ */
+class environment
+{
+  public:
+    environment() = default;
+
+    environment(const environment&) = delete;
+
+    environment& operator=(const environment&) = delete;
+
+    environment(environment&& rhs) noexcept
+      : m_state{rhs.m_state},
+        m_reference{rhs.m_reference},
+        m_isStateAlive{std::move(rhs.m_isStateAlive)}
+    {
+        rhs.m_state = nullptr;
+        rhs.m_reference = LUA_NOREF;
+    }
+
+    environment& operator=(environment&& rhs) noexcept
+    {
+        if (this != &rhs) {
+            release();
+            m_state = rhs.m_state;
+            m_reference = rhs.m_reference;
+            m_isStateAlive = std::move(rhs.m_isStateAlive);
+            rhs.m_state = nullptr;
+            rhs.m_reference = LUA_NOREF;
+        }
+        return *this;
+    }
+
+    ~environment() { release(); }
+
+    /**
+     * \brief Hands out an empty environment of state, taken from its pool
+     * when one has been released, created otherwise
+     */
+    static environment acquire(lua_State* state)
+    {
+        state_lifetime::flag is_state_alive = state_lifetime::watch(state);
+        {
+            std::lock_guard<std::mutex> lock(get_mutex());
+            auto& pool = get_pools()[state];
+            if (!pool.empty()) {
+                int reference = pool.back();
+                pool.pop_back();
+                return environment{state, reference, std::move(is_state_alive)};
+            }
+        }
+        lua_newtable(state);
+        push_metatable(state);
+        lua_setmetatable(state, -2);
+        return environment{state, luaL_ref(state, LUA_REGISTRYINDEX), std::move(is_state_alive)};
+    }
+
+    /**
+     * \brief Clears the table and returns it to the pool, the handle is empty
+     * afterwards
+     */
+    void release()
+    {
+        if (m_state == nullptr) {
+            return;
+        }
+        if (!*m_isStateAlive) {
+            forget();
+            return;
+        }
+        push();
+        int table_index = lua_gettop(m_state);
+        lua_pushnil(m_state);
+        while (lua_next(m_state, table_index) != 0) {
+            // Clearing the fields during the traversal is allowed by lua_next
+            lua_pop(m_state, 1);
+            lua_pushvalue(m_state, -1);
+            lua_pushnil(m_state);
+            lua_rawset(m_state, table_index);
+        }
+        // The code could have replaced the metatable through setmetatable
+        push_metatable(m_state);
+        lua_setmetatable(m_state, table_index);
+        lua_pop(m_state, 1);
+        {
+            std::lock_guard<std::mutex> lock(get_mutex());
+            get_pools()[m_state].push_back(m_reference);
+        }
+        forget();
+    }
+
+    /// Whether the handle is armed and can be used on the stack of state
+    bool belongs_to(lua_State* state) const
+    {
+        return static_cast<bool>(*this) && m_state == state;
+    }
+
+    /**
+     * \brief Pushes the environment table onto the stack
+     * \pre belongs_to(state())
+     */
+    void push() const { lua_rawgeti(m_state, LUA_REGISTRYINDEX, m_reference); }
+
+    lua_State* state() const { return m_state; }
+
+    /// false once released or once its lua state has been removed
+    explicit operator bool() const { return m_state != nullptr && *m_isStateAlive; }
+
+    /// Forgets the pooled tables of state, called when the state is closed
+    static void remove(lua_State* state)
+    {
+        std::lock_guard<std::mutex> lock(get_mutex());
+        get_pools().erase(state);
+    }
+
+  private:
+    environment(lua_State* state, int reference, state_lifetime::flag is_state_alive)
+      : m_state{state}, m_reference{reference}, m_isStateAlive{std::move(is_state_alive)}
+    {
+    }
+
+    void forget()
+    {
+        m_state = nullptr;
+        m_reference = LUA_NOREF;
+        m_isStateAlive.reset();
+    }
+
+    /// Pushes the metatable shared by the environments of state, {__index = globals}
+    static void push_metatable(lua_State* state)
+    {
+        if (luaL_newmetatable(state, "luabz.environment") != 0) {
+            interface::push_globals(state);
+            lua_setfield(state, -2, "__index");
+        }
+    }
+
+    static std::mutex& get_mutex()
+    {
+        static std::mutex environments_mutex{};
+        return environments_mutex;
+    }
+
+    /// Registry references of the released environment tables of every state
+    static std::unordered_map<lua_State*, std::vector<int>>& get_pools()
+    {
+        static std::unordered_map<lua_State*, std::vector<int>> pools{};
+        return pools;
+    }
+
+    lua_State* m_state = nullptr;
+
+    int m_reference = LUA_NOREF;
+
+    /// Cleared once the lifetime of m_state ends
+    state_lifetime::flag m_isStateAlive{};
+};
+
+/**
+ * \brief RAII helper running a lua function in an environment, the previous
+ * environment of the function is restored by the destructor
+ * \pre The function stays at function_index for the whole scope
+ * \note Nothing is swapped when env doesn't belong to state
+ */
+class environment_scope
+{
+  public:
+    environment_scope(lua_State* state, int function_index, const environment& env)
+      : m_state{state}, m_functionIndex{interface::absolute_index(state, function_index)}
+    {
+        if (!env.belongs_to(m_state) || !lua_isfunction(m_state, m_functionIndex) ||
+            !interface::push_environment(m_state, m_functionIndex)) {
+            return;
+        }
+        m_previousIndex = lua_gettop(m_state);
+        env.push();
+        interface::set_environment(m_state, m_functionIndex);
+    }
+
+    environment_scope(const environment_scope&) = delete;
+
+    environment_scope& operator=(const environment_scope&) = delete;
+
+    ~environment_scope()
+    {
+        if (m_previousIndex != 0) {
+            lua_pushvalue(m_state, m_previousIndex);
+            interface::set_environment(m_state, m_functionIndex);
+        }
+    }
+
+  private:
+    lua_State* m_state;
+
+    int m_functionIndex;
+
+    /// Stack index of the previous environment, 0 when the function has none
+    int m_previousIndex = 0;
+};
+}  // namespace luabz
@@ -3,25 +3,73 @@
 #include <cstdio>
 #include <exception>
 #include <string>
+#include <utility>
 namespace luabz
 {
 /**
  * \brief Reports an error generated in lua
  *
  * It handles errors in two different ways \n
- * 1 - When the compiler flag USE_CPP_EXCEPTIONS is set on, it throws an
+ * 1 - When the compiler flag LUABZ_USE_CPP_EXCEPTIONS is set on, it throws an
  * exception whenever there is an error \n 2 - When the compiler flag
- * USE_CPP_EXCEPTIONS is set off (default), it logs the error in a txt file
+ * LUABZ_USE_CPP_EXCEPTIONS is set off (default), it logs the error in a txt file
  * called error and executes an always false assert
  */
 // TODO:Improve error handling
-inline void error(const std::string& error_message)
+inline void error(const std::string& error_message, error_kind kind = error_kind::runtime)
 {
-#ifdef USE_CPP_EXCEPTIONS
-    throw luabz_exception(message);
+#ifdef LUABZ_USE_CPP_EXCEPTIONS
+    throw luabz_exception(error_message, kind);
 #else
     std::printf("%s", error_message.c_str());
+    static_cast<void>(kind);
     // std::terminate();
 #endif
 }
+
+/**
+ * \brief Describes an error reported by the fallible API (try_get, try_call)
+ * \note Only the raw pieces of the error are stored, the human readable
+ * message is formatted when requested through message()
+ */
+class error_info
+{
+  public:
+    error_info(error_kind kind, std::string variable_name, std::string lua_message = "")
+      : m_kind{kind}, m_variableName{std::move(variable_name)}, m_luaMessage{std::move(lua_message)}
+    {
+    }
+
+    error_kind kind() const noexcept { return m_kind; }
+
+    const std::string& variable_name() const noexcept { return m_variableName; }
+
+    /// The error message generated by lua, empty when the error is detected by luabz
+    const std::string& lua_message() const noexcept { return m_luaMessage; }
+
+    std::string message() const
+    {
+        switch (m_kind) {
+            case error_kind::budget_exceeded:
+                return m_variableName + " exceeded its execution budget: " + m_luaMessage;
+            case error_kind::not_a_table:
+                return m_variableName + " cannot be accessed, one of its parents is not a table";
+            case error_kind::not_a_function:
+                return m_variableName + " is neither a Lua function nor a C/C++ function";
+            case error_kind::type_mismatch:
+                return m_variableName + " cannot be converted to the requested type";
+            case error_kind::invalid_environment:
+                return m_variableName + " cannot run in an empty environment or in one of "
+                                        "another lua state";
+            case error_kind::runtime:
+                break;
+        }
+        return m_variableName + ": " + m_luaMessage;
+    }
+
+  private:
+    error_kind m_kind;
+    std::string m_variableName;
+    std::string m_luaMessage;
+};
 }  // namespace luabz
\ No newline at end of file
@@ -0,0 +1,274 @@
+#pragma once
+#include "error.hpp"
+#include "script.hpp"
+#include "state_lifetime.hpp"
+#include "value.hpp"
+#include "var_loader.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <lua.hpp>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace luabz
+{
+/**
+ * \brief Bounded lock-free queue with many producers and a single consumer
+ *
+ * A ring of cells, each carrying a sequence number which tells the producers
+ * whether the cell is free and the consumer whether it's filled. Producers
+ * reserve a cell with a single compare-and-swap on the enqueue position and
+ * never wait on each other nor on the consumer: try_push fails when the ring
+ * is full. \n
+ * The capacity is rounded up to a power of two.
+ * \pre T is default constructible and move assignable. try_pop is called by
+ * one thread at a time.
+ */
+template <typename T>
+class mpsc_queue
+{
+  public:
+    explicit mpsc_queue(std::size_t capacity)
+      : m_mask{round_up(capacity) - 1}, m_cells{new cell[m_mask + 1]}
+    {
+        for (std::size_t i = 0; i <= m_mask; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    mpsc_queue(const mpsc_queue&) = delete;
+
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    /// Returns false, leaving event untouched, when the queue is full
+    template <typename U>
+    bool try_push(U&& event)
+    {
+        std::size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+        cell* target = nullptr;
+        for (;;) {
+            target = &m_cells[position & m_mask];
+            std::size_t sequence = target->sequence.load(std::memory_order_acquire);
+            auto difference =
+                static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+            if (difference == 0) {
+                if (m_enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                            std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        target->event = std::forward<U>(event);
+        target->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Returns false when the queue is empty
+    bool try_pop(T& event)
+    {
+        cell& source = m_cells[m_dequeuePosition & m_mask];
+        std::size_t sequence = source.sequence.load(std::memory_order_acquire);
+        if (sequence != m_dequeuePosition + 1) {
+            return false;
+        }
+        event = std::move(source.event);
+        // The cell is free again for the producers of the next lap
+        source.sequence.store(m_dequeuePosition + m_mask + 1, std::memory_order_release);
+        ++m_dequeuePosition;
+        return true;
+    }
+
+    std::size_t capacity() const { return m_mask + 1; }
+
+  private:
+    static constexpr std::size_t cache_line_size = 64;
+
+    struct cell {
+        std::atomic<std::size_t> sequence;
+        T event;
+    };
+
+    static std::size_t round_up(std::size_t capacity)
+    {
+        std::size_t result = 2;
+        while (result < capacity) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const std::size_t m_mask;
+
+    const std::unique_ptr<cell[]> m_cells;
+
+    /// Shared by the producers, kept on its own cache line
+    alignas(cache_line_size) std::atomic<std::size_t> m_enqueuePosition{0};
+
+    /// Touched only by the consumer
+    alignas(cache_line_size) std::size_t m_dequeuePosition = 0;
+};
+
+/// How event_dispatcher passes the events to the lua handler
+enum class dispatch_mode {
+    /// One call per drained batch, with the events in an array table
+    batch,
+    /// One call per event, with the event as argument
+    per_event
+};
+
+/**
+ * \brief Consumer of a mpsc_queue, which drains the events in batches and
+ * passes them to a lua handler
+ *
+ * The handler is looked up once and pinned in the registry, so the dispatch
+ * doesn't resolve its name again. In dispatch_mode::batch the handler is called
+ * once per batch with an array table presized to the batch, which amortizes
+ * the cost of lua_pcall over the whole batch. \n
+ * Events are pushed through luabz::value<T>::insert, aggregates described with
+ * LUABZ_FIELDS become tables.
+ * \note drain has to be called by the thread using the script, the producers
+ * never touch the lua state. Once the script is closed the dispatcher drains
+ * nothing and its destructor leaves the closed state alone.
+ */
+template <typename T>
+class event_dispatcher
+{
+  public:
+    event_dispatcher(const script& target,
+                     const std::string& handler_name,
+                     mpsc_queue<T>& queue,
+                     dispatch_mode mode = dispatch_mode::batch,
+                     std::size_t max_batch = 256)
+      : m_state{target.m_state},
+        m_queue{queue},
+        m_mode{mode},
+        m_maxBatch{max_batch == 0 ? 1 : max_batch},
+        m_handlerName{handler_name},
+        m_isStateAlive{state_lifetime::watch(m_state)}
+    {
+        var_loader loader(m_state, handler_name);
+        if (!lua_isfunction(m_state, -1)) {
+            error(handler_name + " is not a function, and cannot handle events",
+                  error_kind::not_a_function);
+            return;
+        }
+        m_handler = luaL_ref(m_state, LUA_REGISTRYINDEX);
+        m_batch.reserve(m_maxBatch);
+    }
+
+    event_dispatcher(const event_dispatcher&) = delete;
+
+    event_dispatcher& operator=(const event_dispatcher&) = delete;
+
+    ~event_dispatcher()
+    {
+        if (*m_isStateAlive) {
+            luaL_unref(m_state, LUA_REGISTRYINDEX, m_handler);
+        }
+    }
+
+    /**
+     * \brief Pops up to max_batch events and passes them to the handler
+     * \return The number of events popped, 0 when the queue is empty
+     * \note An error raised by the handler is reported through luabz::error,
+     * the events of the failed call are dropped
+     */
+    std::size_t drain()
+    {
+        if (m_handler == LUA_NOREF || !*m_isStateAlive) {
+            return 0;
+        }
+        T event{};
+        while (m_batch.size() < m_maxBatch && m_queue.try_pop(event)) {
+            m_batch.push_back(std::move(event));
+        }
+        std::size_t count = m_batch.size();
+        if (count == 0) {
+            return 0;
+        }
+        // The batch is dropped even when the handler throws
+        batch_guard guard{m_batch};
+        if (m_mode == dispatch_mode::batch) {
+            dispatch_batch();
+        } else {
+            dispatch_events();
+        }
+        return count;
+    }
+
+    /// Drains until the queue is empty, returns the number of events dispatched
+    std::size_t drain_all()
+    {
+        std::size_t total = 0;
+        for (std::size_t drained = drain(); drained != 0; drained = drain()) {
+            total += drained;
+        }
+        return total;
+    }
+
+  private:
+    struct batch_guard {
+        std::vector<T>& batch;
+        ~batch_guard() { batch.clear(); }
+    };
+
+    void dispatch_batch()
+    {
+        int top = lua_gettop(m_state);
+        lua_rawgeti(m_state, LUA_REGISTRYINDEX, m_handler);
+        lua_createtable(m_state, static_cast<int>(m_batch.size()), 0);
+        for (std::size_t i = 0; i < m_batch.size(); ++i) {
+            value<T>::insert(m_state, m_batch[i]);
+            lua_rawseti(m_state, -2, static_cast<int>(i + 1));
+        }
+        call_handler(top, 1);
+    }
+
+    void dispatch_events()
+    {
+        int top = lua_gettop(m_state);
+        for (const T& current : m_batch) {
+            lua_rawgeti(m_state, LUA_REGISTRYINDEX, m_handler);
+            value<T>::insert(m_state, current);
+            call_handler(top, 1);
+        }
+    }
+
+    void call_handler(int top, int arguments_count)
+    {
+        if (lua_pcall(m_state, arguments_count, 0, 0) != 0) {
+            std::string error_message = m_handlerName + ": ";
+            error_message += lua_tostring(m_state, -1);
+            lua_settop(m_state, top);
+            error(error_message);
+            return;
+        }
+        lua_settop(m_state, top);
+    }
+
+    lua_State* m_state;
+
+    mpsc_queue<T>& m_queue;
+
+    dispatch_mode m_mode;
+
+    std::size_t m_maxBatch;
+
+    std::string m_handlerName;
+
+    int m_handler = LUA_NOREF;
+
+    /// Cleared once the script is closed
+    state_lifetime::flag m_isStateAlive;
+
+    /// Reused between the drains, so a drain doesn't allocate
+    std::vector<T> m_batch{};
+};
+}  // namespace luabz
@@ -0,0 +1,178 @@
+#pragma once
+#include "error.hpp"
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace luabz
+{
+/**
+ * \brief Wrapper used to construct an expected holding an error
+ */
+template <typename E>
+class unexpected
+{
+  public:
+    explicit unexpected(E error_value) : m_error{std::move(error_value)} {}
+
+    const E& value() const& { return m_error; }
+
+    E&& value() && { return std::move(m_error); }
+
+  private:
+    E m_error;
+};
+
+template <typename E>
+unexpected<typename std::decay<E>::type> make_unexpected(E&& error_value)
+{
+    return unexpected<typename std::decay<E>::type>(std::forward<E>(error_value));
+}
+
+/**
+ * \brief Holds either the result of an operation or the error which prevented
+ * it, used by the fallible API which doesn't report errors through
+ * luabz::error
+ */
+template <typename T, typename E>
+class expected
+{
+  public:
+    expected(const T& result) : m_hasValue{true} { new (&m_value) T(result); }
+
+    expected(T&& result) : m_hasValue{true} { new (&m_value) T(std::move(result)); }
+
+    expected(unexpected<E> error_value) : m_hasValue{false}
+    {
+        new (&m_error) E(std::move(error_value).value());
+    }
+
+    expected(const expected& rhs) : m_hasValue{rhs.m_hasValue}
+    {
+        if (m_hasValue) {
+            new (&m_value) T(rhs.m_value);
+        } else {
+            new (&m_error) E(rhs.m_error);
+        }
+    }
+
+    expected(expected&& rhs) noexcept(std::is_nothrow_move_constructible<T>::value &&
+                                      std::is_nothrow_move_constructible<E>::value)
+      : m_hasValue{rhs.m_hasValue}
+    {
+        if (m_hasValue) {
+            new (&m_value) T(std::move(rhs.m_value));
+        } else {
+            new (&m_error) E(std::move(rhs.m_error));
+        }
+    }
+
+    expected& operator=(const expected& rhs)
+    {
+        if (this != &rhs) {
+            if (m_hasValue && rhs.m_hasValue) {
+                m_value = rhs.m_value;
+            } else if (!m_hasValue && !rhs.m_hasValue) {
+                m_error = rhs.m_error;
+            } else {
+                // A throwing copy leaves the object untouched
+                expected copy(rhs);
+                replace(std::move(copy));
+            }
+        }
+        return *this;
+    }
+
+    expected& operator=(expected&& rhs)
+    {
+        if (this != &rhs) {
+            if (m_hasValue && rhs.m_hasValue) {
+                m_value = std::move(rhs.m_value);
+            } else if (!m_hasValue && !rhs.m_hasValue) {
+                m_error = std::move(rhs.m_error);
+            } else {
+                replace(std::move(rhs));
+            }
+        }
+        return *this;
+    }
+
+    ~expected() { destroy(); }
+
+    bool has_value() const noexcept { return m_hasValue; }
+
+    explicit operator bool() const noexcept { return m_hasValue; }
+
+    /**
+     * \pre has_value() is true, otherwise the error is reported through
+     * luabz::error
+     * \note Without LUABZ_USE_CPP_EXCEPTIONS luabz::error returns, there is no
+     * value to return then and the program is terminated
+     */
+    const T& value() const&
+    {
+        check_value();
+        return m_value;
+    }
+
+    T& value() &
+    {
+        check_value();
+        return m_value;
+    }
+
+    template <typename U>
+    T value_or(U&& default_value) const&
+    {
+        return m_hasValue ? m_value : static_cast<T>(std::forward<U>(default_value));
+    }
+
+    const T& operator*() const& { return m_value; }
+
+    T& operator*() & { return m_value; }
+
+    const T* operator->() const { return &m_value; }
+
+    T* operator->() { return &m_value; }
+
+    /// \pre has_value() is false
+    const E& error() const& { return m_error; }
+
+  private:
+    void check_value() const
+    {
+        if (!m_hasValue) {
+            luabz::error(m_error.message(), m_error.kind());
+#ifndef LUABZ_USE_CPP_EXCEPTIONS
+            std::terminate();
+#endif
+        }
+    }
+
+    /// Switches to the alternative held by rhs, which is moved without throwing
+    void replace(expected&& rhs)
+    {
+        static_assert(std::is_nothrow_move_constructible<T>::value &&
+                          std::is_nothrow_move_constructible<E>::value,
+                      "expected assignment needs types which can be moved without throwing");
+        destroy();
+        new (this) expected(std::move(rhs));
+    }
+
+    void destroy()
+    {
+        if (m_hasValue) {
+            m_value.~T();
+        } else {
+            m_error.~E();
+        }
+    }
+
+    bool m_hasValue;
+    union {
+        T m_value;
+        E m_error;
+    };
+};
+}  // namespace luabz
@@ -0,0 +1,188 @@
+#pragma once
+#include "error.hpp"
+#include "interface.hpp"
+#include "value.hpp"
+#include <cstddef>
+#include <lua.hpp>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace luabz
+{
+/**
+ * \brief Describes a single data member of an aggregate mapped to a lua table
+ */
+template <typename Class, typename Member>
+struct field {
+    const char* name;
+    Member Class::*member;
+};
+
+template <typename Class, typename Member>
+constexpr field<Class, Member> make_field(const char* name, Member Class::*member)
+{
+    return field<Class, Member>{name, member};
+}
+
+/**
+ * \brief Compile-time list of the fields of T
+ * \note Specializations are generated by LUABZ_FIELDS, every specialization
+ * provides a static member function called "list" returning a std::tuple of
+ * luabz::field
+ */
+template <typename T>
+struct fields;
+
+/**
+ * \brief Implementation of luabz::value for every type described with
+ * LUABZ_FIELDS
+ *
+ * The aggregate is read from the lua table in a single pass, the field names
+ * are interned once per lua state into an array stored in the registry, so
+ * each field lookup is a raw array access followed by a table access.
+ */
+template <typename T>
+struct struct_value {
+    static void insert(lua_State* state, const T& object)
+    {
+        lua_createtable(state, 0, static_cast<int>(field_count));
+        push_keys(state);
+        for_each_field([state, &object](const auto& f, std::size_t i) {
+            using member_type = typename std::decay<decltype(object.*(f.member))>::type;
+            lua_rawgeti(state, -1, static_cast<int>(i + 1));
+            value<member_type>::insert(state, object.*(f.member));
+            lua_rawset(state, -4);
+        });
+        lua_pop(state, 1);
+    }
+
+    /// \note Only the type of the table is checked, not the type of its fields
+    static bool is(lua_State* state, int stack_index)
+    {
+        return interface::is_table(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static T get(lua_State* state, int stack_index, Policy policy = Policy{})
+    {
+        T object{};
+        int table_index = interface::absolute_index(state, stack_index);
+        if (!lua_istable(state, table_index)) {
+            error("The lua variable is not a table and cannot be converted to a C++ aggregate");
+            return object;
+        }
+        push_keys(state);
+        int keys_index = lua_gettop(state);
+        for_each_field([state, policy, &object, table_index, keys_index](const auto& f,
+                                                                           std::size_t i) {
+            using member_type = typename std::decay<decltype(object.*(f.member))>::type;
+            lua_rawgeti(state, keys_index, static_cast<int>(i + 1));
+            lua_gettable(state, table_index);
+            object.*(f.member) = value<member_type>::get(state, -1, policy);
+            lua_pop(state, 1);
+        });
+        lua_pop(state, 1);
+        return object;
+    }
+
+  private:
+    using field_list = decltype(fields<T>::list());
+
+    static constexpr std::size_t field_count = std::tuple_size<field_list>::value;
+
+    /// Address used as the registry key of the interned field names
+    static char registry_key;
+
+    /**
+     * \brief Pushes to the top of the stack the array containing the interned
+     * field names, creating it the first time it is requested by a lua state
+     */
+    static void push_keys(lua_State* state)
+    {
+        lua_pushlightuserdata(state, static_cast<void*>(&registry_key));
+        lua_rawget(state, LUA_REGISTRYINDEX);
+        if (lua_istable(state, -1)) {
+            return;
+        }
+        lua_pop(state, 1);
+        lua_createtable(state, static_cast<int>(field_count), 0);
+        for_each_field([state](const auto& f, std::size_t i) {
+            lua_pushstring(state, f.name);
+            lua_rawseti(state, -2, static_cast<int>(i + 1));
+        });
+        lua_pushlightuserdata(state, static_cast<void*>(&registry_key));
+        lua_pushvalue(state, -2);
+        lua_rawset(state, LUA_REGISTRYINDEX);
+    }
+
+    template <typename F>
+    static void for_each_field(F&& f)
+    {
+        for_each_field(std::forward<F>(f), std::make_index_sequence<field_count>());
+    }
+
+    template <typename F, std::size_t... I>
+    static void for_each_field(F&& f, std::index_sequence<I...>&& /*unused*/)
+    {
+        constexpr field_list list = fields<T>::list();
+        using expander = int[];
+        (void)expander{0, (f(std::get<I>(list), I), 0)...};
+    }
+};
+
+template <typename T>
+char struct_value<T>::registry_key = 0;
+}  // namespace luabz
+
+#define LUABZ_DETAIL_FIELD(Type, name) ::luabz::make_field(#name, &Type::name)
+#define LUABZ_DETAIL_FE_1(m, t, x) m(t, x)
+#define LUABZ_DETAIL_FE_2(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_1(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_3(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_2(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_4(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_3(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_5(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_4(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_6(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_5(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_7(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_6(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_8(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_7(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_9(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_8(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_10(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_9(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_11(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_10(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_12(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_11(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_13(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_12(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_14(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_13(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_15(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_14(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_FE_16(m, t, x, ...) m(t, x), LUABZ_DETAIL_FE_15(m, t, __VA_ARGS__)
+#define LUABZ_DETAIL_SELECT_FE(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, \
+                               _16, NAME, ...)                                                   \
+    NAME
+#define LUABZ_DETAIL_FOR_EACH(m, t, ...)                                                          \
+    LUABZ_DETAIL_SELECT_FE(__VA_ARGS__, LUABZ_DETAIL_FE_16, LUABZ_DETAIL_FE_15,                   \
+                           LUABZ_DETAIL_FE_14, LUABZ_DETAIL_FE_13, LUABZ_DETAIL_FE_12,            \
+                           LUABZ_DETAIL_FE_11, LUABZ_DETAIL_FE_10, LUABZ_DETAIL_FE_9,             \
+                           LUABZ_DETAIL_FE_8, LUABZ_DETAIL_FE_7, LUABZ_DETAIL_FE_6,               \
+                           LUABZ_DETAIL_FE_5, LUABZ_DETAIL_FE_4, LUABZ_DETAIL_FE_3,               \
+                           LUABZ_DETAIL_FE_2, LUABZ_DETAIL_FE_1, unused)                          \
+    (m, t, __VA_ARGS__)
+
+/**
+ * \brief Maps the aggregate Type to a lua table with one field per listed
+ * data member, e.g. LUABZ_FIELDS(Position, x, y, z);
+ * \note Has to be used in the global namespace, supports up to 16 fields.
+ * Every data member must have a luabz::value specialization.
+ */
+#define LUABZ_FIELDS(Type, ...)                                                      \
+    namespace luabz                                                                  \
+    {                                                                                \
+    template <>                                                                      \
+    struct fields<Type> {                                                            \
+        static constexpr auto list()                                                 \
+        {                                                                            \
+            return std::make_tuple(LUABZ_DETAIL_FOR_EACH(LUABZ_DETAIL_FIELD, Type,   \
+                                                         __VA_ARGS__));              \
+        }                                                                            \
+    };                                                                               \
+    template <>                                                                      \
+    struct value<Type> : struct_value<Type> {                                        \
+    };                                                                               \
+    }                                                                                \
+    static_assert(true, "")
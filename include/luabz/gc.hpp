@@ -0,0 +1,272 @@
+#pragma once
+#include "interface.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <lua.hpp>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace luabz
+{
+enum class gc_mode { incremental, generational };
+
+/// Outcome of garbage_collector::step_for
+struct gc_step_result {
+    /// Number of basic steps run
+    std::uint64_t steps = 0;
+    /// Whether a collection cycle has been finished by the steps
+    bool cycle_finished = false;
+    std::chrono::nanoseconds elapsed{0};
+};
+
+/**
+ * \brief Statistics of the garbage collection work requested through
+ * garbage_collector
+ * \note The work done by lua on its own, during the allocations, is not
+ * accounted
+ */
+struct gc_stats {
+    std::size_t memory_bytes = 0;
+    std::uint64_t steps = 0;
+    std::uint64_t cycles = 0;
+    std::uint64_t collections = 0;
+    std::uint64_t total_ns = 0;
+    /// Longest single request, a step_for, a step or a collect
+    std::uint64_t max_pause_ns = 0;
+};
+
+/**
+ * \brief Control of the garbage collector of a lua state, through lua_gc
+ *
+ * Meant to keep the collection off the request path: stop the automatic
+ * collection, or raise its pause, and let the event loop run the collection
+ * in the idle gaps with step_for, e.g. gc.step_for(std::chrono::microseconds{200}).
+ * \note A handle, copies control the same lua state. The statistics are kept
+ * per lua state until remove is called, script::close does it.
+ */
+class garbage_collector
+{
+  public:
+    explicit garbage_collector(lua_State* state) : m_state{state} {}
+
+    /**
+     * \brief Sets how long the collector waits before a new cycle, in percent
+     * of the memory in use after the previous one, e.g. 200 waits for the
+     * memory to double
+     * \return The previous value
+     */
+    int set_pause(int percent) { return lua_gc(m_state, LUA_GCSETPAUSE, percent); }
+
+    /**
+     * \brief Sets the speed of the collector relative to the allocations, in
+     * percent
+     * \return The previous value
+     */
+    int set_step_multiplier(int percent) { return lua_gc(m_state, LUA_GCSETSTEPMUL, percent); }
+
+    /// \return false when the mode isn't available in this lua version
+    bool set_mode(gc_mode mode)
+    {
+        return interface::set_generational_gc(m_state, mode == gc_mode::generational);
+    }
+
+    /// Stops the automatic collection, step, step_for and collect keep working
+    void stop()
+    {
+        lua_gc(m_state, LUA_GCSTOP, 0);
+        set_running(false);
+    }
+
+    void restart()
+    {
+        lua_gc(m_state, LUA_GCRESTART, 0);
+        set_running(true);
+    }
+
+    bool is_running() const
+    {
+#ifdef LUA_GCISRUNNING
+        return lua_gc(m_state, LUA_GCISRUNNING, 0) != 0;
+#else
+        std::lock_guard<std::mutex> lock(get_mutex());
+        return get_records()[m_state].running;
+#endif
+    }
+
+    /// Memory in use by the lua state, in bytes
+    std::size_t memory() const
+    {
+        auto kilobytes = static_cast<std::size_t>(lua_gc(m_state, LUA_GCCOUNT, 0));
+        auto bytes = static_cast<std::size_t>(lua_gc(m_state, LUA_GCCOUNTB, 0));
+        return kilobytes * 1024 + bytes;
+    }
+
+    /// Runs a full collection cycle
+    void collect()
+    {
+        bool was_running = is_running();
+        auto start = clock_type::now();
+        lua_gc(m_state, LUA_GCCOLLECT, 0);
+        keep_stopped(was_running);
+        record(0, 1, 1, clock_type::now() - start);
+    }
+
+    /**
+     * \brief Runs a single step of the collection, a basic step when kilobytes
+     * is 0, otherwise the work of allocating as many kilobytes
+     * \return true when the step finished a cycle
+     */
+    bool step(int kilobytes = 0)
+    {
+        bool was_running = is_running();
+        auto start = clock_type::now();
+        bool cycle_finished = lua_gc(m_state, LUA_GCSTEP, kilobytes) != 0;
+        keep_stopped(was_running);
+        record(1, cycle_finished ? 1 : 0, 0, clock_type::now() - start);
+        return cycle_finished;
+    }
+
+    /**
+     * \brief Runs steps of the collection until the budget is spent or a
+     * cycle is finished
+     * \note The budget is checked between the steps, so it's overrun by at
+     * most one step, kilobytes sets the size of a step as in step. Before lua
+     * 5.2 and on LuaJIT a step also pays the debt of the collector, so a
+     * single step can run several basic steps.
+     */
+    gc_step_result step_for(std::chrono::nanoseconds budget, int kilobytes = 0)
+    {
+        gc_step_result result{};
+        bool was_running = is_running();
+        auto start = clock_type::now();
+        auto deadline = start + budget;
+        for (auto now = start; now < deadline; now = clock_type::now()) {
+            ++result.steps;
+            bool cycle_finished = lua_gc(m_state, LUA_GCSTEP, kilobytes) != 0;
+            keep_stopped(was_running);
+            if (cycle_finished) {
+                result.cycle_finished = true;
+                break;
+            }
+        }
+        result.elapsed = clock_type::now() - start;
+        record(result.steps, result.cycle_finished ? 1 : 0, 0, result.elapsed);
+        return result;
+    }
+
+    gc_stats stats() const
+    {
+        gc_stats result{};
+        {
+            std::lock_guard<std::mutex> lock(get_mutex());
+            auto found = get_records().find(m_state);
+            if (found != get_records().end()) {
+                result = found->second.stats;
+            }
+        }
+        result.memory_bytes = memory();
+        return result;
+    }
+
+    std::string dump_stats(metrics_format format = metrics_format::text) const
+    {
+        gc_stats current = stats();
+        std::string report;
+        if (format == metrics_format::json) {
+            report += "{\"gc\":{\"memory_bytes\":" + std::to_string(current.memory_bytes);
+            report += ",\"steps\":" + std::to_string(current.steps);
+            report += ",\"cycles\":" + std::to_string(current.cycles);
+            report += ",\"collections\":" + std::to_string(current.collections);
+            report += ",\"total_ns\":" + std::to_string(current.total_ns);
+            report += ",\"max_pause_ns\":" + std::to_string(current.max_pause_ns);
+            report += "}}";
+            return report;
+        }
+        char line[256];
+        std::snprintf(line, sizeof(line), "%14s %10s %10s %12s %14s %14s\n", "memory(KB)",
+                      "steps", "cycles", "collections", "total(us)", "max_pause(us)");
+        report += line;
+        std::snprintf(line, sizeof(line), "%14.2f %10llu %10llu %12llu %14.2f %14.2f\n",
+                      static_cast<double>(current.memory_bytes) / 1024.0,
+                      static_cast<unsigned long long>(current.steps),
+                      static_cast<unsigned long long>(current.cycles),
+                      static_cast<unsigned long long>(current.collections),
+                      static_cast<double>(current.total_ns) / 1000.0,
+                      static_cast<double>(current.max_pause_ns) / 1000.0);
+        report += line;
+        return report;
+    }
+
+    /// Discards the statistics of state
+    static void remove(lua_State* state)
+    {
+        std::lock_guard<std::mutex> lock(get_mutex());
+        get_records().erase(state);
+    }
+
+  private:
+    using clock_type = std::chrono::steady_clock;
+
+    struct gc_record {
+        gc_stats stats{};
+        /// Tracked for the lua versions which can't be asked, before 5.2
+        bool running = true;
+    };
+
+    void record(std::uint64_t steps,
+                std::uint64_t cycles,
+                std::uint64_t collections,
+                clock_type::duration elapsed)
+    {
+        auto elapsed_ns = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        std::lock_guard<std::mutex> lock(get_mutex());
+        gc_stats& current = get_records()[m_state].stats;
+        current.steps += steps;
+        current.cycles += cycles;
+        current.collections += collections;
+        current.total_ns += elapsed_ns;
+        current.max_pause_ns = std::max(current.max_pause_ns, elapsed_ns);
+    }
+
+    /**
+     * \brief Stops the automatic collection again after a step or a collect,
+     * before lua 5.2 they reset the threshold and so restart it
+     */
+    void keep_stopped(bool was_running)
+    {
+#if LUABZ_LUA_VERSION < 502
+        if (!was_running) {
+            lua_gc(m_state, LUA_GCSTOP, 0);
+        }
+#else
+        static_cast<void>(was_running);
+#endif
+    }
+
+    void set_running(bool running)
+    {
+        std::lock_guard<std::mutex> lock(get_mutex());
+        get_records()[m_state].running = running;
+    }
+
+    static std::mutex& get_mutex()
+    {
+        static std::mutex gc_mutex{};
+        return gc_mutex;
+    }
+
+    static std::unordered_map<lua_State*, gc_record>& get_records()
+    {
+        static std::unordered_map<lua_State*, gc_record> records{};
+        return records;
+    }
+
+    lua_State* m_state;
+};
+}  // namespace luabz
@@ -1,39 +1,142 @@
 #pragma once
 #include <cstdint>
+#include <cstring>
 #include <lua.hpp>
 #include <type_traits>
+#include <vector>
+
+/**
+ * \brief Version of the lua API luabz is compiled against, e.g. 501, 503, 504
+ */
+#define LUABZ_LUA_VERSION LUA_VERSION_NUM
+
+#if LUABZ_LUA_VERSION >= 503
+/// Defined when lua has a native 64 bit integer subtype
+#define LUABZ_LUA_NATIVE_INTEGERS
+#endif
+
+#ifdef LUAJIT_VERSION
+/// Defined when compiled against LuaJIT, whose lua.hpp includes luajit.h
+#define LUABZ_LUAJIT
+#endif
 
 namespace luabz
 {
+/**
+ * \brief Access policy selecting the checked luaL_check* accessors, a value
+ * of the wrong type raises a lua error. It's the default policy.
+ */
+struct checked {
+};
+
+/**
+ * \brief Access policy selecting the raw lua_to* accessors, which skip the
+ * type check and never raise an error. Meant for trusted hot loops, a value
+ * of the wrong type is read as 0, false or an empty string.
+ */
+struct unchecked {
+};
+
 /**
  * \brief Used to interface with lua api
+ * \note Every function which differs between the supported lua versions (5.1,
+ * 5.3 and 5.4) is wrapped here, the rest of the library must not use version
+ * specific functions or pseudo-indices such as LUA_GLOBALSINDEX
  */
 struct interface {
-    // TODO:Decide if this should use the checked version or the unchecked once... or both
-    static auto get_long(lua_State* state, std::size_t index)
+    // Every getter takes the access policy as last parameter, checked by default
+    template <typename Policy = checked>
+    static auto get_long(lua_State* state, std::size_t index, Policy policy = Policy{})
     {
-        return luaL_checklong(state, index);
+        return get_integer(state, static_cast<int>(index), policy);
     }
-    static auto get_bool(lua_State* state, std::size_t index)
+    template <typename Policy = checked>
+    static auto get_bool(lua_State* state, std::size_t index, Policy /*unused*/ = Policy{})
     {
         return lua_toboolean(state, index);
     }
-    static auto get_int(lua_State* state, std::size_t index) { return luaL_checkint(state, index); }
-    static auto get_number(lua_State* state, std::size_t index)
+    template <typename Policy = checked>
+    static auto get_int(lua_State* state, std::size_t index, Policy policy = Policy{})
+    {
+        return static_cast<int>(get_integer(state, static_cast<int>(index), policy));
+    }
+    static auto get_number(lua_State* state, std::size_t index, checked /*unused*/ = checked{})
     {
         return luaL_checknumber(state, index);
     }
-    static auto get_string(lua_State* state, std::size_t index)
+    static auto get_number(lua_State* state, std::size_t index, unchecked /*unused*/)
+    {
+        return lua_tonumber(state, index);
+    }
+    static auto get_string(lua_State* state, std::size_t index, checked /*unused*/ = checked{})
     {
         return luaL_checkstring(state, index);
     }
+    static auto get_string(lua_State* state, std::size_t index, unchecked /*unused*/)
+    {
+        return lua_tostring(state, index);
+    }
+    /**
+     * \brief Reads a string and its length, embedded zeros included
+     * \note The unchecked version returns nullptr when the value is neither a
+     * string nor a number
+     */
+    static const char* get_lstring(lua_State* state,
+                                   int index,
+                                   std::size_t& length,
+                                   checked /*unused*/ = checked{})
+    {
+        return luaL_checklstring(state, index, &length);
+    }
+    static const char* get_lstring(lua_State* state,
+                                   int index,
+                                   std::size_t& length,
+                                   unchecked /*unused*/)
+    {
+        return lua_tolstring(state, index, &length);
+    }
+    /**
+     * \brief Reads an integer without going through lua_Number when lua has
+     * native integers, so 64 bit values keep their precision
+     * \note A float without an integer representation is truncated, as on 5.1
+     */
+    static lua_Integer get_integer(lua_State* state, int index, checked /*unused*/ = checked{})
+    {
+#ifdef LUABZ_LUA_NATIVE_INTEGERS
+        int is_integer = 0;
+        lua_Integer result = lua_tointegerx(state, index, &is_integer);
+        if (is_integer != 0) {
+            return result;
+        }
+        return static_cast<lua_Integer>(luaL_checknumber(state, index));
+#else
+        return luaL_checkinteger(state, index);
+#endif
+    }
+    static lua_Integer get_integer(lua_State* state, int index, unchecked /*unused*/)
+    {
+#ifdef LUABZ_LUA_NATIVE_INTEGERS
+        int is_integer = 0;
+        lua_Integer result = lua_tointegerx(state, index, &is_integer);
+        if (is_integer != 0) {
+            return result;
+        }
+        return static_cast<lua_Integer>(lua_tonumber(state, index));
+#else
+        return lua_tointeger(state, index);
+#endif
+    }
+
+    static bool is_bool(lua_State* state, int index) { return lua_isboolean(state, index); }
+    static bool is_number(lua_State* state, int index) { return lua_isnumber(state, index) != 0; }
+    static bool is_string(lua_State* state, int index) { return lua_isstring(state, index) != 0; }
+    static bool is_table(lua_State* state, int index) { return lua_istable(state, index); }
 
     static void insert_bool(lua_State* state, bool value) { lua_pushboolean(state, value ? 1 : 0); }
-    /// TODO:This is missing enable if
-    template <typename T>
+    template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
     static void insert_integer(lua_State* state, T value)
     {
-        lua_pushinteger(state, value);
+        lua_pushinteger(state, static_cast<lua_Integer>(value));
     }
     template <typename T,
               typename = typename std::enable_if<std::is_floating_point<T>::value>::type>
@@ -45,5 +148,323 @@ struct interface {
     {
         lua_pushcclosure(state, f, upvalues_count);
     }
+    /// Converts a relative stack index to an absolute one, pseudo-indices are left untouched
+    static int absolute_index(lua_State* state, int index)
+    {
+        bool is_relative = (index < 0 && index > LUA_REGISTRYINDEX);
+        return is_relative ? lua_gettop(state) + index + 1 : index;
+    }
+
+    /// Pushes onto the stack the value of the global variable name
+    static void get_global(lua_State* state, const char* name)
+    {
+#if LUABZ_LUA_VERSION >= 502
+        lua_getglobal(state, name);
+#else
+        lua_getfield(state, LUA_GLOBALSINDEX, name);
+#endif
+    }
+
+    /// Pops a value from the stack and sets it as the value of the global variable name
+    static void set_global(lua_State* state, const char* name)
+    {
+#if LUABZ_LUA_VERSION >= 502
+        lua_setglobal(state, name);
+#else
+        lua_setfield(state, LUA_GLOBALSINDEX, name);
+#endif
+    }
+
+    /// Compares the two values with the lua semantic of ==, metamethods included
+    static int equal(lua_State* state, int index1, int index2)
+    {
+#if LUABZ_LUA_VERSION >= 502
+        return lua_compare(state, index1, index2, LUA_OPEQ);
+#else
+        return lua_equal(state, index1, index2);
+#endif
+    }
+
+    /// Compares the two values with the lua semantic of <, metamethods included
+    static int less_than(lua_State* state, int index1, int index2)
+    {
+#if LUABZ_LUA_VERSION >= 502
+        return lua_compare(state, index1, index2, LUA_OPLT);
+#else
+        return lua_lessthan(state, index1, index2);
+#endif
+    }
+
+    /// Field of the package library holding the functions used by require to find modules
+    static constexpr const char* searchers_field =
+#if LUABZ_LUA_VERSION >= 502
+        "searchers";
+#else
+        "loaders";
+#endif
+
+    /// Pushes onto the stack the table holding the global variables
+    static void push_globals(lua_State* state)
+    {
+#if LUABZ_LUA_VERSION >= 502
+        lua_rawgeti(state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+#else
+        lua_pushvalue(state, LUA_GLOBALSINDEX);
+#endif
+    }
+
+    /**
+     * \brief Pushes the environment of the lua function at index, the table in
+     * which its globals are resolved
+     * \return false, pushing nothing, when the function has no environment, e.g.
+     * a C function or, since 5.2, a function which doesn't access any global
+     */
+    static bool push_environment(lua_State* state, int index)
+    {
+        index = absolute_index(state, index);
+#if LUABZ_LUA_VERSION >= 502
+        int upvalue = environment_upvalue(state, index);
+        if (upvalue == 0) {
+            return false;
+        }
+        lua_getupvalue(state, index, upvalue);
+#else
+        if (lua_iscfunction(state, index) != 0) {
+            return false;
+        }
+        lua_getfenv(state, index);
+#endif
+        return true;
+    }
+
+    /**
+     * \brief Pops a table and sets it as the environment of the lua function at
+     * index
+     * \note Since 5.2 the environment is the _ENV upvalue, which is shared by
+     * all the functions defined by the same chunk
+     * \return false when the function has no environment
+     */
+    static bool set_environment(lua_State* state, int index)
+    {
+        index = absolute_index(state, index);
+#if LUABZ_LUA_VERSION >= 502
+        int upvalue = environment_upvalue(state, index);
+        if (upvalue == 0) {
+            lua_pop(state, 1);
+            return false;
+        }
+        lua_setupvalue(state, index, upvalue);
+        return true;
+#else
+        if (lua_iscfunction(state, index) != 0) {
+            lua_pop(state, 1);
+            return false;
+        }
+        return lua_setfenv(state, index) != 0;
+#endif
+    }
+
+#if LUABZ_LUA_VERSION >= 502
+    /// Position of the _ENV upvalue of the function at index, 0 when there is none
+    static int environment_upvalue(lua_State* state, int index)
+    {
+        for (int upvalue = 1;; ++upvalue) {
+            const char* name = lua_getupvalue(state, index, upvalue);
+            if (name == nullptr) {
+                return 0;
+            }
+            lua_pop(state, 1);
+            if (std::strcmp(name, "_ENV") == 0) {
+                return upvalue;
+            }
+        }
+    }
+#endif
+
+    /**
+     * \brief Appends to output the bytecode of the function on the top of the
+     * stack
+     * \return false when the function cannot be dumped, e.g. a C function
+     */
+    static bool dump_function(lua_State* state, std::vector<char>& output)
+    {
+        lua_Writer writer = [](lua_State* /*unused*/, const void* data, size_t size, void* ud) {
+            auto bytes = static_cast<const char*>(data);
+            auto buffer = static_cast<std::vector<char>*>(ud);
+            buffer->insert(buffer->end(), bytes, bytes + size);
+            return 0;
+        };
+#if LUABZ_LUA_VERSION >= 503
+        return lua_dump(state, writer, &output, 0) == 0;
+#else
+        return lua_dump(state, writer, &output) == 0;
+#endif
+    }
+
+    /**
+     * \brief Loads a chunk, source or precompiled, read through reader
+     * \return The status of the load, on failure the error message is pushed
+     */
+    static int load(lua_State* state, lua_Reader reader, void* data, const char* chunk_name)
+    {
+#if LUABZ_LUA_VERSION >= 502
+        return lua_load(state, reader, data, chunk_name, nullptr);
+#else
+        return lua_load(state, reader, data, chunk_name);
+#endif
+    }
+
+    /**
+     * \brief Loads a precompiled chunk and pushes it as a function
+     * \note Source code is rejected where lua allows to choose, so a buffer
+     * produced by dump_function can't be swapped for arbitrary code
+     * \return The status of the load, on failure the error message is pushed
+     */
+    static int load_bytecode(lua_State* state, const char* data, std::size_t size, const char* name)
+    {
+#if LUABZ_LUA_VERSION >= 502
+        return luaL_loadbufferx(state, data, size, name, "b");
+#else
+        return luaL_loadbuffer(state, data, size, name);
+#endif
+    }
+
+    /**
+     * \brief Turns off the JIT compiler of LuaJIT, whose compiled traces don't
+     * run the count hooks, no-op for the other lua versions
+     * \return Whether the compiler was on, to be passed to resume_jit
+     * \note Turning the compiler off flushes the compiled traces of the state
+     */
+    static bool suspend_jit(lua_State* state)
+    {
+#ifdef LUABZ_LUAJIT
+        bool was_enabled = is_jit_enabled(state);
+        if (was_enabled) {
+            luaJIT_setmode(state, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_OFF);
+        }
+        return was_enabled;
+#else
+        (void)state;
+        return false;
+#endif
+    }
+
+    static void resume_jit(lua_State* state, bool was_enabled)
+    {
+#ifdef LUABZ_LUAJIT
+        if (was_enabled) {
+            luaJIT_setmode(state, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_ON);
+        }
+#else
+        (void)state;
+        (void)was_enabled;
+#endif
+    }
+
+    /**
+     * \brief Switches the garbage collector between the generational and the
+     * incremental mode, keeping the parameters of the mode
+     * \return false when the generational mode isn't available, as before 5.2
+     * and on 5.3
+     */
+    static bool set_generational_gc(lua_State* state, bool generational)
+    {
+#if LUABZ_LUA_VERSION >= 504
+        if (generational) {
+            lua_gc(state, LUA_GCGEN, 0, 0);
+        } else {
+            lua_gc(state, LUA_GCINC, 0, 0, 0);
+        }
+        return true;
+#elif LUABZ_LUA_VERSION == 502
+        lua_gc(state, generational ? LUA_GCGEN : LUA_GCINC, 0);
+        return true;
+#else
+        (void)state;
+        return !generational;
+#endif
+    }
+
+#ifdef LUABZ_LUAJIT
+    /// Type of the FFI cdata values returned by lua_type, not exposed by lua.h
+    static constexpr int cdata_type = 10;
+
+    static bool is_cdata(lua_State* state, int index)
+    {
+        return lua_type(state, index) == cdata_type;
+    }
+
+    /**
+     * \brief Whether the JIT compiler is on, as reported by jit.status
+     * \note The compiler is on by default, so when the jit module isn't loaded
+     */
+    static bool is_jit_enabled(lua_State* state)
+    {
+        int top = lua_gettop(state);
+        bool is_enabled = true;
+        lua_getfield(state, LUA_REGISTRYINDEX, "_LOADED");
+        if (lua_istable(state, -1)) {
+            lua_getfield(state, -1, "jit");
+        }
+        if (lua_istable(state, -1)) {
+            lua_getfield(state, -1, "status");
+            if (lua_pcall(state, 0, 1, 0) == 0) {
+                is_enabled = lua_toboolean(state, -1) != 0;
+            }
+        }
+        lua_settop(state, top);
+        return is_enabled;
+    }
+
+    /**
+     * \brief Whether a cdata is a pointer or a reference, whose memory holds
+     * the address of the data instead of the data
+     * \note Asks ffi.typeof, the C API doesn't expose the C type. Without the
+     * ffi module loaded the only cdata are the 64-bit and complex numbers.
+     */
+    static bool is_pointer_cdata(lua_State* state, int index)
+    {
+        index = absolute_index(state, index);
+        int top = lua_gettop(state);
+        bool is_pointer = false;
+        lua_getfield(state, LUA_REGISTRYINDEX, "_LOADED");
+        if (lua_istable(state, -1)) {
+            lua_getfield(state, -1, "ffi");
+        }
+        if (lua_istable(state, -1)) {
+            lua_getfield(state, -1, "typeof");
+            lua_pushvalue(state, index);
+            // The C type prints as "ctype<double *>" or "ctype<double &>"
+            if (lua_pcall(state, 1, 1, 0) == 0 && luaL_callmeta(state, -1, "__tostring") != 0) {
+                std::size_t size = 0;
+                const char* name = lua_tolstring(state, -1, &size);
+                is_pointer = name != nullptr && size >= 2 && name[size - 1] == '>' &&
+                             (name[size - 2] == '*' || name[size - 2] == '&');
+            }
+        }
+        lua_settop(state, top);
+        return is_pointer;
+    }
+
+    /**
+     * \brief Returns the address of the memory of a cdata, or the pointer of a
+     * light userdata
+     * \note Since LuaJIT 2.1 lua_topointer returns the cdata payload
+     */
+    static void* get_cdata(lua_State* state, int index)
+    {
+        return const_cast<void*>(lua_topointer(state, index));
+    }
+#endif
+
+    /// Length of a string, table or userdata without invoking metamethods
+    static std::size_t raw_length(lua_State* state, int index)
+    {
+#if LUABZ_LUA_VERSION >= 502
+        return static_cast<std::size_t>(lua_rawlen(state, index));
+#else
+        return lua_objlen(state, index);
+#endif
+    }
 };
 }  // namespace luabz
@@ -3,6 +3,24 @@
 #include <string>
 namespace luabz
 {
+/**
+ * \brief The category of an error reported by luabz
+ */
+enum class error_kind {
+    /// Error raised by the lua code or by the lua api
+    runtime,
+    /// The instruction budget or the deadline of a call has been exceeded
+    budget_exceeded,
+    /// One of the parents of a table field is not a table
+    not_a_table,
+    /// The called variable is neither a lua function nor a C/C++ function
+    not_a_function,
+    /// The lua value cannot be converted to the requested C++ type
+    type_mismatch,
+    /// The environment handle is empty or belongs to another lua state
+    invalid_environment
+};
+
 /**
  * \brief A class used to report any kind of error that lua can generate
  *
@@ -13,10 +31,21 @@ namespace luabz
 class luabz_exception : public std::runtime_error
 {
   public:
-    explicit luabz_exception(const std::string& msg) : std::runtime_error(msg) {}
+    explicit luabz_exception(const std::string& msg, error_kind kind = error_kind::runtime)
+      : std::runtime_error(msg), m_kind{kind}
+    {
+    }
 
-    explicit luabz_exception(const char* msg) : std::runtime_error(msg) {}
+    explicit luabz_exception(const char* msg, error_kind kind = error_kind::runtime)
+      : std::runtime_error(msg), m_kind{kind}
+    {
+    }
 
     const char* what() const noexcept override { return std::runtime_error::what(); }
+
+    error_kind kind() const noexcept { return m_kind; }
+
+  private:
+    error_kind m_kind;
 };
 }  // namespace luabz
\ No newline at end of file
@@ -0,0 +1,142 @@
+#pragma once
+#include "table_range.hpp"
+#include "value.hpp"
+#include <cstddef>
+#include <lua.hpp>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace luabz
+{
+/**
+ * \brief Last parameter of a registered C++ function, receiving the arguments
+ * left after the fixed parameters
+ *
+ * The arguments are read straight from the lua stack, as stack_value, nothing
+ * is converted until asked.
+ * \note Valid only for the duration of the call
+ */
+class variadic_args
+{
+  public:
+    variadic_args(lua_State* state, int first_index, int count)
+      : m_state{state}, m_firstIndex{first_index}, m_count{count < 0 ? 0 : count}
+    {
+    }
+
+    std::size_t size() const { return static_cast<std::size_t>(m_count); }
+
+    bool empty() const { return m_count == 0; }
+
+    stack_value operator[](std::size_t index) const
+    {
+        return stack_value{m_state, m_firstIndex + static_cast<int>(index)};
+    }
+
+  private:
+    lua_State* m_state;
+
+    int m_firstIndex;
+
+    int m_count;
+};
+
+/// Return type and parameters of a registered C++ function, used as a tag
+template <typename ReturnType, typename... Args>
+struct signature {
+};
+
+template <typename ReturnType, typename ArgsTuple>
+struct make_signature;
+
+template <typename ReturnType, typename... Args>
+struct make_signature<ReturnType, std::tuple<Args...>> {
+    using type = signature<ReturnType, Args...>;
+};
+
+/**
+ * \brief Reads a parameter of a registered C++ function from the lua stack,
+ * through luabz::value of the decayed type
+ * \note A const T& parameter binds to the converted value, which isn't copied
+ * again. const char* and std::string_view parameters point into the lua string.
+ */
+template <typename T>
+struct argument {
+    static T get(lua_State* state, int stack_index) { return value<T>::get(state, stack_index); }
+};
+
+template <>
+struct argument<variadic_args> {
+    static variadic_args get(lua_State* state, int stack_index)
+    {
+        return variadic_args{state, stack_index, lua_gettop(state) - stack_index + 1};
+    }
+};
+
+/**
+ * \brief Whether a registered C++ function with the parameters Args can be
+ * called with the arguments on the stack, at least the fixed ones when the last
+ * parameter is variadic_args
+ */
+template <typename ReturnType, typename... Args>
+bool accepts_arguments(lua_State* state, signature<ReturnType, Args...> /*unused*/)
+{
+    using last_type = typename std::decay<typename std::tuple_element<
+        sizeof...(Args), std::tuple<void, Args...>>::type>::type;
+    constexpr int fixed_count = static_cast<int>(sizeof...(Args)) -
+                                (std::is_same<last_type, variadic_args>::value ? 1 : 0);
+    int arguments_count = lua_gettop(state);
+    return fixed_count == static_cast<int>(sizeof...(Args)) ? arguments_count == fixed_count
+                                                            : arguments_count >= fixed_count;
+}
+
+/**
+ * \brief Pushes the result of a registered C++ function
+ *
+ * invoke calls the function and returns the number of lua results: none for
+ * void, one per element for a std::tuple, one otherwise.
+ */
+template <typename T>
+struct results {
+    template <typename Call>
+    static int invoke(lua_State* state, Call&& call)
+    {
+        value<T>::insert(state, std::forward<Call>(call)());
+        return 1;
+    }
+};
+
+template <>
+struct results<void> {
+    template <typename Call>
+    static int invoke(lua_State* /*unused*/, Call&& call)
+    {
+        std::forward<Call>(call)();
+        return 0;
+    }
+};
+
+template <typename... Ts>
+struct results<std::tuple<Ts...>> {
+    template <typename Call>
+    static int invoke(lua_State* state, Call&& call)
+    {
+        const std::tuple<Ts...>& result = std::forward<Call>(call)();
+        lua_checkstack(state, static_cast<int>(sizeof...(Ts)));
+        push(state, result, std::index_sequence_for<Ts...>{});
+        return static_cast<int>(sizeof...(Ts));
+    }
+
+  private:
+    template <std::size_t... I>
+    static void push(lua_State* state,
+                     const std::tuple<Ts...>& result,
+                     std::index_sequence<I...> /*unused*/)
+    {
+        using expander = int[];
+        (void)expander{
+            0, (value<typename std::decay<Ts>::type>::insert(state, std::get<I>(result)), 0)...};
+    }
+};
+}  // namespace luabz
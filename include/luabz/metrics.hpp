@@ -0,0 +1,383 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <lua.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace luabz
+{
+/**
+ * \brief Log-linear latency histogram, every power of two is split in
+ * sub_buckets linear buckets, so the relative error of a percentile is at
+ * most 1/sub_buckets
+ */
+class latency_histogram
+{
+  public:
+    static constexpr std::size_t sub_bucket_bits = 3;
+    static constexpr std::size_t sub_buckets = 1U << sub_bucket_bits;
+    static constexpr std::size_t bucket_count = 64 * sub_buckets;
+
+    void record(std::uint64_t value)
+    {
+        ++m_buckets[bucket_index(value)];
+        ++m_count;
+        m_max = std::max(m_max, value);
+    }
+
+    void merge(const latency_histogram& rhs)
+    {
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            m_buckets[i] += rhs.m_buckets[i];
+        }
+        m_count += rhs.m_count;
+        m_max = std::max(m_max, rhs.m_max);
+    }
+
+    /// Returns the upper bound of the bucket containing the requested percentile
+    std::uint64_t percentile(double p) const
+    {
+        if (m_count == 0) {
+            return 0;
+        }
+        auto rank = static_cast<std::uint64_t>(p / 100.0 * static_cast<double>(m_count));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            seen += m_buckets[i];
+            if (seen > rank) {
+                return std::min(bucket_upper_bound(i), m_max);
+            }
+        }
+        return m_max;
+    }
+
+    std::uint64_t count() const { return m_count; }
+
+    std::uint64_t max() const { return m_max; }
+
+    std::uint64_t bucket(std::size_t index) const { return m_buckets[index]; }
+
+    static std::uint64_t bucket_upper_bound(std::size_t index)
+    {
+        if (index < sub_buckets) {
+            return index;
+        }
+        std::size_t magnitude = index / sub_buckets + sub_bucket_bits - 1;
+        std::uint64_t sub_bucket = index % sub_buckets;
+        std::uint64_t base = (sub_buckets + sub_bucket) << (magnitude - sub_bucket_bits);
+        return base + (std::uint64_t{1} << (magnitude - sub_bucket_bits)) - 1;
+    }
+
+  private:
+    static std::size_t bucket_index(std::uint64_t value)
+    {
+        if (value < sub_buckets) {
+            return static_cast<std::size_t>(value);
+        }
+        std::size_t magnitude = 63 - static_cast<std::size_t>(__builtin_clzll(value));
+        std::size_t sub_bucket = (value >> (magnitude - sub_bucket_bits)) & (sub_buckets - 1);
+        return (magnitude - sub_bucket_bits + 1) * sub_buckets + sub_bucket;
+    }
+
+    std::array<std::uint64_t, bucket_count> m_buckets{};
+    std::uint64_t m_count = 0;
+    std::uint64_t m_max = 0;
+};
+
+enum class call_kind { lua_function, cpp_function };
+
+enum class metrics_format { text, json };
+
+/**
+ * \brief Statistics of a single function
+ * \note total_ns includes the marshalling of arguments and results, inner_ns
+ * is the time spent inside the lua function or inside the C++ callable, so
+ * the time spent in marshalling is total_ns - inner_ns
+ */
+struct call_stats {
+    call_kind kind = call_kind::lua_function;
+    std::uint64_t total_ns = 0;
+    std::uint64_t inner_ns = 0;
+    latency_histogram histogram{};
+};
+
+/**
+ * \brief Per lua state collection of call statistics, keyed by variable name
+ * \note Statistics are collected only when the compiler flag
+ * LUABZ_ENABLE_INSTRUMENTATION is defined, otherwise call_timer is a no-op
+ * and the reports are empty
+ * \note Every thread records into its own shard of a state, found through a
+ * thread local cache, so recording never takes the process-wide lock after the
+ * first call of a thread on a state. dump merges the shards of the state.
+ */
+class metrics
+{
+  public:
+    static void record(lua_State* state,
+                       call_kind kind,
+                       const std::string& name,
+                       std::uint64_t total_ns,
+                       std::uint64_t inner_ns)
+    {
+        std::shared_ptr<shard> local = get_local_shard(state);
+        // Only contended while the state is being dumped
+        std::lock_guard<std::mutex> lock(local->mutex);
+        auto& stats = local->stats[name];
+        stats.kind = kind;
+        stats.total_ns += total_ns;
+        stats.inner_ns += inner_ns;
+        stats.histogram.record(total_ns);
+    }
+
+    static void remove(lua_State* state)
+    {
+        std::lock_guard<std::mutex> lock(get_mutex());
+        get_all_shards().erase(state);
+    }
+
+    static std::string dump(lua_State* state, metrics_format format)
+    {
+        std::vector<std::shared_ptr<shard>> state_shards;
+        {
+            std::lock_guard<std::mutex> lock(get_mutex());
+            auto found = get_all_shards().find(state);
+            if (found != get_all_shards().end()) {
+                state_shards = found->second;
+            }
+        }
+        std::map<std::string, call_stats> sorted_stats;
+        for (const auto& state_shard : state_shards) {
+            std::lock_guard<std::mutex> lock(state_shard->mutex);
+            for (const auto& entry : state_shard->stats) {
+                merge(sorted_stats[entry.first], entry.second);
+            }
+        }
+        return format == metrics_format::json ? to_json(sorted_stats) : to_text(sorted_stats);
+    }
+
+  private:
+    using stats_map = std::unordered_map<std::string, call_stats>;
+
+    /// Statistics recorded by a single thread on a single state
+    struct shard {
+        std::mutex mutex{};
+        stats_map stats{};
+    };
+
+    static std::mutex& get_mutex()
+    {
+        static std::mutex metrics_mutex{};
+        return metrics_mutex;
+    }
+
+    static std::unordered_map<lua_State*, std::vector<std::shared_ptr<shard>>>& get_all_shards()
+    {
+        static std::unordered_map<lua_State*, std::vector<std::shared_ptr<shard>>> all_shards{};
+        return all_shards;
+    }
+
+    /**
+     * \brief Returns the shard of the calling thread for state, registering a
+     * new one on the first call
+     * \note The cache holds weak pointers, so a shard dropped by remove isn't
+     * reused by a later state allocated at the same address
+     */
+    static std::shared_ptr<shard> get_local_shard(lua_State* state)
+    {
+        thread_local std::unordered_map<lua_State*, std::weak_ptr<shard>> local_shards{};
+        auto cached = local_shards.find(state);
+        if (cached != local_shards.end()) {
+            if (auto found = cached->second.lock()) {
+                return found;
+            }
+        }
+        for (auto it = local_shards.begin(); it != local_shards.end();) {
+            it = it->second.expired() ? local_shards.erase(it) : std::next(it);
+        }
+        auto created = std::make_shared<shard>();
+        {
+            std::lock_guard<std::mutex> lock(get_mutex());
+            get_all_shards()[state].push_back(created);
+        }
+        local_shards[state] = created;
+        return created;
+    }
+
+    static void merge(call_stats& merged, const call_stats& stats)
+    {
+        merged.kind = stats.kind;
+        merged.total_ns += stats.total_ns;
+        merged.inner_ns += stats.inner_ns;
+        merged.histogram.merge(stats.histogram);
+    }
+
+    static const char* kind_name(call_kind kind)
+    {
+        return kind == call_kind::lua_function ? "lua_function" : "cpp_function";
+    }
+
+    static std::string to_text(const std::map<std::string, call_stats>& sorted_stats)
+    {
+        std::string report;
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-24s %-12s %10s %14s %14s %10s %10s %10s %10s\n",
+                      "name", "kind", "count", "total(us)", "inner(us)", "p50(us)", "p99(us)",
+                      "p999(us)", "max(us)");
+        report += line;
+        for (const auto& entry : sorted_stats) {
+            const call_stats& stats = entry.second;
+            std::snprintf(
+                line, sizeof(line),
+                "%-24s %-12s %10llu %14.2f %14.2f %10.2f %10.2f %10.2f %10.2f\n",
+                entry.first.c_str(), kind_name(stats.kind),
+                static_cast<unsigned long long>(stats.histogram.count()),
+                static_cast<double>(stats.total_ns) / 1000.0,
+                static_cast<double>(stats.inner_ns) / 1000.0,
+                static_cast<double>(stats.histogram.percentile(50.0)) / 1000.0,
+                static_cast<double>(stats.histogram.percentile(99.0)) / 1000.0,
+                static_cast<double>(stats.histogram.percentile(99.9)) / 1000.0,
+                static_cast<double>(stats.histogram.max()) / 1000.0);
+            report += line;
+        }
+        return report;
+    }
+
+    static std::string to_json(const std::map<std::string, call_stats>& sorted_stats)
+    {
+        std::string report = "{\"functions\":[";
+        bool first_function = true;
+        for (const auto& entry : sorted_stats) {
+            const call_stats& stats = entry.second;
+            if (!first_function) {
+                report += ',';
+            }
+            first_function = false;
+            report += "{\"name\":";
+            append_json_string(report, entry.first);
+            report += ",\"kind\":\"";
+            report += kind_name(stats.kind);
+            report += "\",\"count\":" + std::to_string(stats.histogram.count());
+            report += ",\"total_ns\":" + std::to_string(stats.total_ns);
+            report += ",\"inner_ns\":" + std::to_string(stats.inner_ns);
+            report += ",\"p50_ns\":" + std::to_string(stats.histogram.percentile(50.0));
+            report += ",\"p99_ns\":" + std::to_string(stats.histogram.percentile(99.0));
+            report += ",\"p999_ns\":" + std::to_string(stats.histogram.percentile(99.9));
+            report += ",\"max_ns\":" + std::to_string(stats.histogram.max());
+            report += ",\"buckets\":[";
+            bool first_bucket = true;
+            for (std::size_t i = 0; i < latency_histogram::bucket_count; ++i) {
+                if (stats.histogram.bucket(i) == 0) {
+                    continue;
+                }
+                if (!first_bucket) {
+                    report += ',';
+                }
+                first_bucket = false;
+                report += '[' + std::to_string(latency_histogram::bucket_upper_bound(i)) + ',' +
+                          std::to_string(stats.histogram.bucket(i)) + ']';
+            }
+            report += "]}";
+        }
+        report += "]}";
+        return report;
+    }
+
+    static void append_json_string(std::string& output, const std::string& text)
+    {
+        output += '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                output += '\\';
+                output += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                output += escaped;
+            } else {
+                output += c;
+            }
+        }
+        output += '"';
+    }
+};
+
+#ifdef LUABZ_ENABLE_INSTRUMENTATION
+/**
+ * \brief RAII helper measuring a single call, the statistics are recorded
+ * when the timer is destroyed
+ */
+class call_timer
+{
+  public:
+    call_timer(lua_State* state, call_kind kind, const std::string& name)
+      : m_state{state}, m_kind{kind}, m_name{name}, m_start{clock_type::now()}
+    {
+    }
+
+    call_timer(const call_timer&) = delete;
+
+    call_timer& operator=(const call_timer&) = delete;
+
+    ~call_timer()
+    {
+        metrics::record(m_state, m_kind, m_name, elapsed_ns(m_start, clock_type::now()), m_inner);
+    }
+
+    void begin_inner() { m_innerStart = clock_type::now(); }
+
+    void end_inner() { m_inner += elapsed_ns(m_innerStart, clock_type::now()); }
+
+  private:
+    using clock_type = std::chrono::steady_clock;
+
+    static std::uint64_t elapsed_ns(clock_type::time_point begin, clock_type::time_point end)
+    {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+    }
+
+    lua_State* m_state;
+    call_kind m_kind;
+    const std::string& m_name;
+    clock_type::time_point m_start;
+    clock_type::time_point m_innerStart{};
+    std::uint64_t m_inner = 0;
+};
+#else
+class call_timer
+{
+  public:
+    call_timer(lua_State* /*unused*/, call_kind /*unused*/, const std::string& /*unused*/) {}
+
+    void begin_inner() {}
+
+    void end_inner() {}
+};
+#endif
+
+/**
+ * \brief Invokes f and accounts the time spent inside it as inner time of timer
+ * \note The arguments are evaluated before the measurement starts, so their
+ * conversion is accounted as marshalling
+ */
+template <typename F, typename... Args>
+decltype(auto) invoke_timed(call_timer& timer, F&& f, Args&&... args)
+{
+    struct inner_scope {
+        call_timer& m_timer;
+        explicit inner_scope(call_timer& t) : m_timer{t} { m_timer.begin_inner(); }
+        ~inner_scope() { m_timer.end_inner(); }
+    } scope{timer};
+    return std::forward<F>(f)(std::forward<Args>(args)...);
+}
+}  // namespace luabz
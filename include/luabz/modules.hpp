@@ -0,0 +1,189 @@
+#pragma once
+#include "error.hpp"
+#include "interface.hpp"
+#include "reader.hpp"
+#include <lua.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace luabz
+{
+/**
+ * \brief Process wide registry of lua modules, resolved by require from
+ * memory instead of the filesystem
+ *
+ * The registry is populated once per process, with embedded chunks through
+ * add or with files through add_file, which compiles them to bytecode. Every
+ * lua state opened by luabz with the lua std has a searcher installed right
+ * after package.preload, so require of a registered module only costs a
+ * luaL_loadbuffer, the modules which aren't registered are searched as usual.
+ * \note A script can be opened by module name, passing from_module(name) as
+ * file name
+ */
+class module_registry
+{
+  public:
+    /// Prefix marking a file name given to state or script as a module name
+    static constexpr const char* prefix = "module:";
+
+    /**
+     * \brief Registers the lua source or the bytecode of module name,
+     * replacing the previous registration
+     */
+    static void add(const std::string& name, std::string chunk)
+    {
+        auto stored = std::make_shared<const std::string>(std::move(chunk));
+        std::lock_guard<std::mutex> lock(get_mutex());
+        get_modules()[name] = std::move(stored);
+    }
+
+    /**
+     * \brief Registers the lua file at path as module name, compiled to
+     * bytecode so the states requiring it skip the parsing
+     * \return false when the file cannot be loaded, the error is reported
+     * through luabz::error
+     */
+    static bool add_file(const std::string& name, const std::string& path)
+    {
+        std::string bytecode;
+        std::string error_message = compile_file(path, bytecode);
+        if (!error_message.empty()) {
+            error("Cannot register the module " + name + " from " + path + ": " + error_message);
+            return false;
+        }
+        add(name, std::move(bytecode));
+        return true;
+    }
+
+    static bool contains(const std::string& name) { return find(name) != nullptr; }
+
+    static void remove(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(get_mutex());
+        get_modules().erase(name);
+    }
+
+    /**
+     * \brief Loads module name and pushes it as a function
+     * \return The status of the load, on failure the error message is pushed
+     */
+    static int load(lua_State* state, const std::string& name)
+    {
+        auto chunk = find(name);
+        if (chunk == nullptr) {
+            lua_pushfstring(state, "module '%s' is not registered in luabz", name.c_str());
+            return LUA_ERRFILE;
+        }
+        return load_chunk(state, name, *chunk);
+    }
+
+    /**
+     * \brief Installs the searcher of the registry into the package library
+     * of state, after package.preload
+     * \note No-op when the package library isn't loaded or the searcher is
+     * already installed
+     */
+    static void install(lua_State* state)
+    {
+        int top = lua_gettop(state);
+        interface::get_global(state, "package");
+        if (lua_istable(state, -1)) {
+            lua_getfield(state, -1, interface::searchers_field);
+        }
+        if (!lua_istable(state, -1)) {
+            lua_settop(state, top);
+            return;
+        }
+        int searchers_index = lua_gettop(state);
+        auto count = static_cast<int>(interface::raw_length(state, searchers_index));
+        for (int i = 1; i <= count; ++i) {
+            lua_rawgeti(state, searchers_index, i);
+            bool installed = lua_tocfunction(state, -1) == &searcher;
+            lua_pop(state, 1);
+            if (installed) {
+                lua_settop(state, top);
+                return;
+            }
+        }
+        // The first searcher is package.preload, which keeps the precedence
+        for (int i = count; i >= 2; --i) {
+            lua_rawgeti(state, searchers_index, i);
+            lua_rawseti(state, searchers_index, i + 1);
+        }
+        lua_pushcfunction(state, &searcher);
+        lua_rawseti(state, searchers_index, count >= 1 ? 2 : 1);
+        lua_settop(state, top);
+    }
+
+  private:
+    static std::shared_ptr<const std::string> find(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(get_mutex());
+        auto found = get_modules().find(name);
+        return found == get_modules().end() ? nullptr : found->second;
+    }
+
+    static int load_chunk(lua_State* state, const std::string& name, const std::string& chunk)
+    {
+        std::string chunk_name = "=" + name;
+        return luaL_loadbuffer(state, chunk.data(), chunk.size(), chunk_name.c_str());
+    }
+
+    /**
+     * \brief Searcher called by require, returns the loader of a registered module
+     * \note luaL_checkstring and lua_error longjmp with the C build of lua, so
+     * they run while no C++ object is alive, the lookup is done by search
+     */
+    static int searcher(lua_State* state)
+    {
+        luaL_checkstring(state, 1);
+        int results_count = search(state);
+        if (results_count < 0) {
+            return lua_error(state);
+        }
+        return results_count;
+    }
+
+    /// \return The results count of the searcher, -1 when the chunk fails to load
+    static int search(lua_State* state)
+    {
+        std::size_t name_size = 0;
+        const char* name_data = lua_tolstring(state, 1, &name_size);
+        std::string name(name_data, name_size);
+        auto chunk = find(name);
+        if (chunk == nullptr) {
+            lua_pushfstring(state, "\n\tno module '%s' in the luabz registry", name.c_str());
+            return 1;
+        }
+        if (load_chunk(state, name, *chunk) != 0) {
+            return -1;  // The error message is on the top of the stack
+        }
+        lua_pushstring(state, name.c_str());
+        return 2;
+    }
+
+    static std::mutex& get_mutex()
+    {
+        static std::mutex modules_mutex{};
+        return modules_mutex;
+    }
+
+    static std::unordered_map<std::string, std::shared_ptr<const std::string>>& get_modules()
+    {
+        static std::unordered_map<std::string, std::shared_ptr<const std::string>> modules{};
+        return modules;
+    }
+};
+
+/**
+ * \brief File name under which state and script open the registered module
+ * name instead of a file
+ */
+inline std::string from_module(const std::string& name)
+{
+    return module_registry::prefix + name;
+}
+}  // namespace luabz
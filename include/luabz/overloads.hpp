@@ -0,0 +1,304 @@
+#pragma once
+#include "fields.hpp"
+#include "marshal.hpp"
+#include "traits/callable_traits.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <lua.hpp>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace luabz
+{
+/**
+ * \brief The lua type accepted by a parameter of type T of an overload,
+ * LUA_TNONE when any lua value is accepted
+ * \note Can be specialized for user types, with the decayed type
+ */
+template <typename T, typename = void>
+struct lua_type_of : std::integral_constant<int, LUA_TNONE> {
+};
+
+template <>
+struct lua_type_of<bool> : std::integral_constant<int, LUA_TBOOLEAN> {
+};
+
+template <typename T>
+struct lua_type_of<T,
+                   typename std::enable_if<std::is_arithmetic<T>::value &&
+                                           !std::is_same<T, bool>::value &&
+                                           !std::is_same<T, char>::value>::type>
+  : std::integral_constant<int, LUA_TNUMBER> {
+};
+
+template <>
+struct lua_type_of<char> : std::integral_constant<int, LUA_TSTRING> {
+};
+
+template <>
+struct lua_type_of<std::string> : std::integral_constant<int, LUA_TSTRING> {
+};
+
+template <>
+struct lua_type_of<const char*> : std::integral_constant<int, LUA_TSTRING> {
+};
+
+#ifdef LUABZ_HAS_STRING_VIEW
+template <>
+struct lua_type_of<std::string_view> : std::integral_constant<int, LUA_TSTRING> {
+};
+#endif
+
+template <>
+struct lua_type_of<std::nullptr_t> : std::integral_constant<int, LUA_TNIL> {
+};
+
+/// Aggregates described with LUABZ_FIELDS are read from lua tables
+template <typename T>
+struct lua_type_of<T, decltype(static_cast<void>(fields<T>::list()))>
+  : std::integral_constant<int, LUA_TTABLE> {
+};
+
+/**
+ * \brief Lua types expected by an overload, packed four bits per parameter
+ *
+ * The argument types of a call are packed the same way, so an overload is
+ * matched by a single mask and compare, whatever its number of parameters.
+ * Only the first max_checked_arguments parameters are checked.
+ */
+struct overload_signature {
+    static constexpr int max_checked_arguments = 16;
+
+    std::uint64_t types;
+
+    std::uint64_t mask;
+
+    int fixed_count;
+
+    bool is_variadic;
+
+    /// Packs the lua types of the arguments on the stack, at most max_checked_arguments
+    static std::uint64_t pack_arguments(lua_State* state, int arguments_count)
+    {
+        std::uint64_t packed = 0;
+        int checked_count =
+            arguments_count < max_checked_arguments ? arguments_count : max_checked_arguments;
+        for (int i = 0; i < checked_count; ++i) {
+            packed |= pack(lua_type(state, i + 1), i);
+        }
+        return packed;
+    }
+
+    static constexpr std::uint64_t pack(int type, int position)
+    {
+        // LUA_TNONE is -1, every lua type fits in four bits once shifted by one
+        return static_cast<std::uint64_t>(type + 1) << (4 * position);
+    }
+
+    static constexpr std::uint64_t slot(int position)
+    {
+        return static_cast<std::uint64_t>(0xF) << (4 * position);
+    }
+
+    constexpr bool accepts_count(int arguments_count) const
+    {
+        return is_variadic ? arguments_count >= fixed_count : arguments_count == fixed_count;
+    }
+
+    bool accepts_types(std::uint64_t packed_arguments) const
+    {
+        return (packed_arguments & mask) == types;
+    }
+
+    bool accepts(std::uint64_t packed_arguments, int arguments_count) const
+    {
+        return accepts_count(arguments_count) && accepts_types(packed_arguments);
+    }
+};
+
+/**
+ * \brief Overloads accepting each number of arguments, up to
+ * max_checked_arguments, in the order in which they were given
+ */
+template <std::size_t N>
+struct overload_dispatch_table {
+    static constexpr int arities_count = overload_signature::max_checked_arguments + 1;
+
+    std::size_t candidates[arities_count][N];
+
+    std::size_t candidates_count[arities_count];
+};
+
+template <std::size_t N>
+constexpr overload_dispatch_table<N> make_overload_dispatch_table(
+    const std::array<overload_signature, N>& signatures)
+{
+    overload_dispatch_table<N> table{};
+    for (int arity = 0; arity < overload_dispatch_table<N>::arities_count; ++arity) {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < N; ++i) {
+            if (signatures[i].accepts_count(arity)) {
+                table.candidates[arity][count] = i;
+                ++count;
+            }
+        }
+        table.candidates_count[arity] = count;
+    }
+    return table;
+}
+
+template <typename ReturnType, typename... Args>
+constexpr overload_signature make_overload_signature(signature<ReturnType, Args...> /*unused*/)
+{
+    constexpr std::size_t count = sizeof...(Args);
+    // The extra element keeps the array valid for functions without parameters
+    constexpr int lua_types[] = {lua_type_of<typename std::decay<Args>::type>::value...,
+                                 LUA_TNONE};
+    constexpr bool is_variadic[] = {
+        std::is_same<typename std::decay<Args>::type, variadic_args>::value..., false};
+    overload_signature result{0, 0, static_cast<int>(count), false};
+    if (count != 0 && is_variadic[count - 1]) {
+        result.fixed_count -= 1;
+        result.is_variadic = true;
+    }
+    for (int i = 0; i < result.fixed_count && i < overload_signature::max_checked_arguments;
+         ++i) {
+        if (lua_types[i] != LUA_TNONE) {
+            result.types |= overload_signature::pack(lua_types[i], i);
+            result.mask |= overload_signature::slot(i);
+        }
+    }
+    return result;
+}
+
+/**
+ * \brief Set of C++ callables registered as a single lua function, which
+ * dispatches each call to the first overload accepting its arguments
+ *
+ * The signatures of the overloads and a table of the candidates for each
+ * number of arguments are computed at compile time. A call indexes the table
+ * with lua_gettop, packs the lua types of its arguments once and picks among
+ * the candidates of that arity with one mask and compare each, then jumps to
+ * the overload through a table indexed by its position; no conversion is
+ * attempted before the pick. \n
+ * Arguments are matched on their lua type: numbers for arithmetic parameters,
+ * strings for std::string, const char* and std::string_view, tables for the
+ * aggregates described with LUABZ_FIELDS, any value for the other types and for
+ * variadic_args. Numbers are not matched by strings, nor strings by numbers.
+ * \note Overloads which lua can't tell apart, e.g. int and double, are resolved
+ * in favour of the first one. A call matching no overload is reported by
+ * dispatch, var_ref::assign raises it as a lua error.
+ * \sa luabz::overloads
+ */
+template <typename... Fs>
+class overload_set
+{
+  public:
+    static_assert(sizeof...(Fs) != 0, "An overload set needs at least one callable");
+
+    explicit overload_set(Fs... functions) : m_functions{std::move(functions)...} {}
+
+    /// Index of the overload accepting the arguments on the stack, size() when none does
+    std::size_t find(lua_State* state) const
+    {
+        static constexpr std::array<overload_signature, sizeof...(Fs)> signatures{
+            {make_overload_signature(signature_of<Fs>{})...}};
+        static constexpr overload_dispatch_table<sizeof...(Fs)> table =
+            make_overload_dispatch_table(signatures);
+        int arguments_count = lua_gettop(state);
+        std::uint64_t packed = overload_signature::pack_arguments(state, arguments_count);
+        if (arguments_count < table.arities_count) {
+            for (std::size_t c = 0; c < table.candidates_count[arguments_count]; ++c) {
+                std::size_t index = table.candidates[arguments_count][c];
+                if (signatures[index].accepts_types(packed)) {
+                    return index;
+                }
+            }
+            return size();
+        }
+        // Longer calls can only match the variadic overloads, or very long ones
+        for (std::size_t i = 0; i < signatures.size(); ++i) {
+            if (signatures[i].accepts(packed, arguments_count)) {
+                return i;
+            }
+        }
+        return size();
+    }
+
+    /**
+     * \brief Calls invoker with the overload accepting the arguments on the
+     * stack and its luabz::signature
+     * \return The result of invoker, -1 when no overload accepts the
+     * arguments, see push_no_overload_error
+     */
+    template <typename Invoker>
+    int dispatch(lua_State* state, Invoker&& invoker) const
+    {
+        std::size_t index = find(state);
+        if (index == size()) {
+            return -1;
+        }
+        return dispatch_to<Invoker>(index, invoker, std::index_sequence_for<Fs...>{});
+    }
+
+    static constexpr std::size_t size() { return sizeof...(Fs); }
+
+  private:
+    template <typename F>
+    using signature_of = typename make_signature<utilitybz::callable_return_type_t<F>,
+                                                 utilitybz::callable_args_types_t<F>>::type;
+
+    template <typename Invoker, std::size_t... I>
+    int dispatch_to(std::size_t index,
+                    Invoker& invoker,
+                    std::index_sequence<I...> /*unused*/) const
+    {
+        using caller = int (*)(const overload_set&, Invoker&);
+        static constexpr caller callers[] = {&call_overload<I, Invoker>...};
+        return callers[index](*this, invoker);
+    }
+
+    template <std::size_t I, typename Invoker>
+    static int call_overload(const overload_set& set, Invoker& invoker)
+    {
+        using function_type = typename std::tuple_element<I, std::tuple<Fs...>>::type;
+        return invoker(std::get<I>(set.m_functions), signature_of<function_type>{});
+    }
+
+    std::tuple<Fs...> m_functions;
+};
+
+/**
+ * \brief Pushes the message of a call matching no overload, e.g.
+ * "no overload of describe accepts (number, table)"
+ */
+inline void push_no_overload_error(lua_State* state, const char* function_name)
+{
+    int arguments_count = lua_gettop(state);
+    lua_pushfstring(state, "no overload of %s accepts (", function_name);
+    for (int i = 1; i <= arguments_count; ++i) {
+        lua_pushstring(state, luaL_typename(state, i));
+        if (i != arguments_count) {
+            lua_pushliteral(state, ", ");
+            lua_concat(state, 3);
+        } else {
+            lua_concat(state, 2);
+        }
+    }
+    lua_pushliteral(state, ")");
+    lua_concat(state, 2);
+}
+
+/**
+ * \brief Groups callables into an overload_set, to be registered with
+ * var_ref::assign as a single lua function
+ */
+template <typename... Fs>
+overload_set<typename std::decay<Fs>::type...> overloads(Fs&&... functions)
+{
+    return overload_set<typename std::decay<Fs>::type...>{std::forward<Fs>(functions)...};
+}
+}  // namespace luabz
@@ -0,0 +1,174 @@
+#pragma once
+#include "script.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <lua.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace luabz
+{
+/**
+ * \brief Sampling profiler for the lua code run by a script
+ *
+ * While running, the lua call stack is sampled every instruction_period
+ * instructions through a count hook and aggregated as folded stacks, one line
+ * per distinct stack in the form "root;caller;leaf count", ready for
+ * flamegraph.pl. \n
+ * The hook is installed only while the profiler is running, so a stopped
+ * profiler costs nothing.
+ * \note Lua supports a single hook per state, while the profiler is running it
+ * replaces any other hook, which is restored by stop. LuaJIT doesn't run the
+ * hooks inside compiled traces, so its JIT compiler is turned off while the
+ * profiler is running, the samples show the interpreted execution.
+ */
+class profiler
+{
+  public:
+    explicit profiler(const script& profiled_script,
+                      int instruction_period = 1000,
+                      std::size_t max_depth = 64)
+      : m_state{profiled_script.m_state},
+        m_instructionPeriod{std::max(instruction_period, 1)},
+        m_maxDepth{max_depth}
+    {
+    }
+
+    profiler(const profiler&) = delete;
+
+    profiler& operator=(const profiler&) = delete;
+
+    ~profiler() { stop(); }
+
+    void start()
+    {
+        if (m_running) {
+            return;
+        }
+        m_previousHook = lua_gethook(m_state);
+        m_previousMask = lua_gethookmask(m_state);
+        m_previousCount = lua_gethookcount(m_state);
+        lua_pushlightuserdata(m_state, registry_key());
+        lua_pushlightuserdata(m_state, static_cast<void*>(this));
+        lua_rawset(m_state, LUA_REGISTRYINDEX);
+        m_jitWasEnabled = interface::suspend_jit(m_state);
+        lua_sethook(m_state, &profiler::hook, LUA_MASKCOUNT, m_instructionPeriod);
+        m_running = true;
+    }
+
+    void stop()
+    {
+        if (!m_running) {
+            return;
+        }
+        lua_sethook(m_state, m_previousHook, m_previousMask, m_previousCount);
+        interface::resume_jit(m_state, m_jitWasEnabled);
+        lua_pushlightuserdata(m_state, registry_key());
+        lua_pushnil(m_state);
+        lua_rawset(m_state, LUA_REGISTRYINDEX);
+        m_running = false;
+    }
+
+    bool is_running() const { return m_running; }
+
+    /// Discards every sample collected so far
+    void reset()
+    {
+        m_stacks.clear();
+        m_samples = 0;
+    }
+
+    std::size_t samples() const { return m_samples; }
+
+    /**
+     * \brief Returns the collected samples as folded stacks
+     */
+    std::string folded() const
+    {
+        std::string result;
+        for (const auto& stack : m_stacks) {
+            result += stack.first;
+            result += ' ';
+            result += std::to_string(stack.second);
+            result += '\n';
+        }
+        return result;
+    }
+
+  private:
+    /// Address used as the registry key of the running profiler
+    static void* registry_key()
+    {
+        static char key = 0;
+        return &key;
+    }
+
+    static void hook(lua_State* state, lua_Debug* /*unused*/)
+    {
+        lua_pushlightuserdata(state, registry_key());
+        lua_rawget(state, LUA_REGISTRYINDEX);
+        auto* active_profiler = static_cast<profiler*>(lua_touserdata(state, -1));
+        lua_pop(state, 1);
+        if (active_profiler != nullptr) {
+            active_profiler->sample(state);
+        }
+    }
+
+    void sample(lua_State* state)
+    {
+        m_frames.clear();
+        lua_Debug frame;
+        for (int level = 0; static_cast<std::size_t>(level) < m_maxDepth; ++level) {
+            if (lua_getstack(state, level, &frame) == 0) {
+                break;
+            }
+            lua_getinfo(state, "Sln", &frame);
+            m_frames.push_back(frame);
+        }
+        m_stack.clear();
+        for (auto frame_it = m_frames.rbegin(); frame_it != m_frames.rend(); ++frame_it) {
+            if (!m_stack.empty()) {
+                m_stack += ';';
+            }
+            append_frame(*frame_it);
+        }
+        ++m_stacks[m_stack];
+        ++m_samples;
+    }
+
+    void append_frame(const lua_Debug& frame)
+    {
+        if (frame.name != nullptr) {
+            m_stack += frame.name;
+        } else if (frame.what != nullptr && frame.what[0] == 'm') {
+            m_stack += "main chunk";
+        } else {
+            m_stack += '?';
+        }
+        if (frame.currentline > 0) {
+            m_stack += " (";
+            m_stack += frame.short_src;
+            m_stack += ':';
+            m_stack += std::to_string(frame.currentline);
+            m_stack += ')';
+        } else if (frame.what != nullptr && frame.what[0] == 'C') {
+            m_stack += " [C]";
+        }
+    }
+
+    lua_State* m_state;
+    int m_instructionPeriod;
+    std::size_t m_maxDepth;
+    bool m_running = false;
+    lua_Hook m_previousHook = nullptr;
+    int m_previousMask = 0;
+    int m_previousCount = 0;
+    bool m_jitWasEnabled = false;
+    std::size_t m_samples = 0;
+    std::unordered_map<std::string, std::size_t> m_stacks{};
+    /// Buffers reused between samples, so a sample of a known stack doesn't allocate
+    std::vector<lua_Debug> m_frames{};
+    std::string m_stack{};
+};
+}  // namespace luabz
@@ -0,0 +1,166 @@
+#pragma once
+#include "interface.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <lua.hpp>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+/// Defined when files can be loaded through mmap
+#define LUABZ_HAS_MMAP
+#endif
+
+namespace luabz
+{
+/**
+ * \brief lua_Reader handing lua a whole memory buffer in a single piece
+ * \note The buffer isn't copied, it has to outlive the call to lua_load
+ */
+class buffer_reader
+{
+  public:
+    buffer_reader(const char* data, std::size_t size) : m_data{data}, m_size{size} {}
+
+    /// Loads the buffer as a chunk and pushes it as a function, see lua_load
+    int load(lua_State* state, const char* chunk_name)
+    {
+        return interface::load(state, &buffer_reader::read, this, chunk_name);
+    }
+
+  private:
+    static const char* read(lua_State* /*unused*/, void* data, std::size_t* size)
+    {
+        auto reader = static_cast<buffer_reader*>(data);
+        if (reader->m_consumed || reader->m_size == 0) {
+            *size = 0;
+            return nullptr;
+        }
+        reader->m_consumed = true;
+        *size = reader->m_size;
+        return reader->m_data;
+    }
+
+    const char* m_data;
+
+    std::size_t m_size;
+
+    bool m_consumed = false;
+};
+
+#ifdef LUABZ_HAS_MMAP
+/**
+ * \brief Read-only memory mapped view of a whole file, advised for a
+ * sequential read
+ */
+class mapped_file
+{
+  public:
+    explicit mapped_file(const std::string& path)
+    {
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            return;
+        }
+        struct stat status {
+        };
+        if (::fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+            auto size = static_cast<std::size_t>(status.st_size);
+            void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (data != MAP_FAILED) {
+                ::madvise(data, size, MADV_SEQUENTIAL);
+                m_data = static_cast<const char*>(data);
+                m_size = size;
+            }
+        }
+        // The mapping stays valid once the descriptor is closed
+        ::close(descriptor);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file()
+    {
+        if (m_data != nullptr) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+    /// False when the file cannot be mapped, e.g. it's missing, empty or not a regular file
+    bool is_mapped() const { return m_data != nullptr; }
+
+    const char* data() const { return m_data; }
+
+    std::size_t size() const { return m_size; }
+
+  private:
+    const char* m_data = nullptr;
+
+    std::size_t m_size = 0;
+};
+#endif
+
+/**
+ * \brief Loads a lua file as a chunk and pushes it as a function, like
+ * luaL_loadfile, reading the file through mmap where available
+ * \note A UTF-8 byte order mark and then a first line starting with '#',
+ * e.g. a shebang, are skipped as by luaL_loadfile since 5.2. Files which
+ * cannot be mapped go through luaL_loadfile.
+ * \return The status of the load, on failure the error message is pushed
+ */
+inline int load_file(lua_State* state, const std::string& path)
+{
+#ifdef LUABZ_HAS_MMAP
+    mapped_file file{path};
+    if (file.is_mapped()) {
+        const char* begin = file.data();
+        const char* end = begin + file.size();
+        static const char utf8_bom[] = "\xEF\xBB\xBF";
+        if (file.size() >= 3 && std::equal(utf8_bom, utf8_bom + 3, begin)) {
+            begin += 3;
+        }
+        if (begin != end && *begin == '#') {
+            // The newline is kept, so the line numbers of the errors are right
+            while (begin != end && *begin != '\n') {
+                ++begin;
+            }
+        }
+        std::string chunk_name = "@" + path;
+        buffer_reader reader{begin, static_cast<std::size_t>(end - begin)};
+        return reader.load(state, chunk_name.c_str());
+    }
+#endif
+    return luaL_loadfile(state, path.c_str());
+}
+
+/**
+ * \brief Compiles a lua file to bytecode on a scratch lua state, safe to be
+ * called from any thread
+ * \return An empty string on success, the error message otherwise
+ */
+inline std::string compile_file(const std::string& path, std::string& bytecode)
+{
+    lua_State* compiler = luaL_newstate();
+    if (compiler == nullptr) {
+        return "Cannot create a new lua_State";
+    }
+    std::string error_message;
+    std::vector<char> output;
+    if (load_file(compiler, path) != 0) {
+        const char* message = lua_tostring(compiler, -1);
+        error_message = message != nullptr ? message : "Cannot load " + path;
+    } else if (!interface::dump_function(compiler, output)) {
+        error_message = "Cannot dump the bytecode of " + path;
+    } else {
+        bytecode.assign(output.begin(), output.end());
+    }
+    lua_close(compiler);
+    return error_message;
+}
+}  // namespace luabz
@@ -1,7 +1,13 @@
 #pragma once
+#include "budget.hpp"
+#include "environment.hpp"
 #include "error.hpp"
+#include "gc.hpp"
 #include "luabz_exception.hpp"
+#include "metrics.hpp"
+#include "reader.hpp"
 #include "state.hpp"
+#include "state_lifetime.hpp"
 #include "var_ref.hpp"
 #include <algorithm>
 #include <lua.hpp>
@@ -10,21 +16,45 @@
 
 namespace luabz
 {
+class profiler;
+template <typename T>
+class event_dispatcher;
 /**
  * \brief The class through which the user interacts with lua
  */
 class script
 {
+    friend class luabz::profiler;
+    template <typename T>
+    friend class luabz::event_dispatcher;
+
   private:
     std::string m_fileName;
     lua_State* m_state;
     bool m_isStateActive;
+    bool m_ownsState;
 
   public:
-    script() : m_fileName{""}, m_state{nullptr}, m_isStateActive{false} {}
+    script() : m_fileName{""}, m_state{nullptr}, m_isStateActive{false}, m_ownsState{false} {}
 
     explicit script(const std::string& file, bool load_lua_std = false)
-      : m_fileName{file}, m_state{state::get(file, load_lua_std)}, m_isStateActive{true}
+      : m_fileName{file},
+        m_state{state::get(file, load_lua_std)},
+        m_isStateActive{true},
+        m_ownsState{false}
+    {
+    }
+
+    /**
+     * \brief Associates the object with a lua state of its own, which is not
+     * shared with the other scripts opened on the same file
+     * \note Used when the same lua file has to be run from different threads
+     */
+    script(const std::string& file, unique_state_t /*unused*/, bool load_lua_std = false)
+      : m_fileName{file},
+        m_state{state::create(file, load_lua_std)},
+        m_isStateActive{true},
+        m_ownsState{true}
     {
     }
 
@@ -35,9 +65,31 @@ class script
 
     script& operator=(const script& rhs) = delete;
 
-    script(script&& rhs) = default;
+    /// The moved-from script is left closed, so closing it doesn't close the state again
+    script(script&& rhs) noexcept
+      : m_fileName{std::move(rhs.m_fileName)},
+        m_state{rhs.m_state},
+        m_isStateActive{rhs.m_isStateActive},
+        m_ownsState{rhs.m_ownsState}
+    {
+        rhs.release();
+    }
 
-    script& operator=(script&& rhs) = default;
+    /**
+     * \note As for the destructor, the lua state previously associated with the
+     * object isn't closed
+     */
+    script& operator=(script&& rhs) noexcept
+    {
+        if (this != &rhs) {
+            m_fileName = std::move(rhs.m_fileName);
+            m_state = rhs.m_state;
+            m_isStateActive = rhs.m_isStateActive;
+            m_ownsState = rhs.m_ownsState;
+            rhs.release();
+        }
+        return *this;
+    }
 
     /**
      * Associates the object with a lua file
@@ -48,7 +100,7 @@ class script
     void open(bool load_lua_std = false)
     {
         if (!m_isStateActive) {
-            m_state = state::get(m_fileName, load_lua_std);
+            m_state = acquire_state(m_fileName, load_lua_std);
             m_isStateActive = true;
         }
     }
@@ -58,7 +110,20 @@ class script
      */
     void close() noexcept
     {
-        state::close(m_fileName);
+        if (!m_isStateActive) {
+            return;
+        }
+        state_lifetime::end(m_state);
+        metrics::remove(m_state);
+        garbage_collector::remove(m_state);
+        environment::remove(m_state);
+        if (m_ownsState) {
+            if (m_state != nullptr) {
+                state::destroy(m_state);
+            }
+        } else {
+            state::close(m_fileName);
+        }
         // var_ref::remove_registed_cpp_functions(m_state);
         m_state = nullptr;
         m_isStateActive = false;
@@ -74,7 +139,7 @@ class script
         if (m_isStateActive) {
             close();
         }
-        m_state = state::get(file_name, load_lua_std);
+        m_state = acquire_state(file_name, load_lua_std);
         m_isStateActive = true;
         m_fileName = file_name;
     }
@@ -86,8 +151,144 @@ class script
         }
     }
 
+    /**
+     * \brief Runs the lua code enforcing an instruction budget and/or a deadline
+     * \note When the budget is exceeded the execution is interrupted and the error
+     * is reported with error_kind::budget_exceeded
+     */
+    void operator()(const std::string& lua_code, const budget& limit) const
+    {
+        int top = lua_gettop(m_state);
+        budget_guard guard(m_state, limit);
+        if (luaL_dostring(m_state, lua_code.c_str())) {
+            auto kind = guard.exceeded() ? error_kind::budget_exceeded : error_kind::runtime;
+            std::string error_message = lua_tostring(m_state, -1);
+            lua_settop(m_state, top);
+            error(error_message, kind);
+            return;
+        }
+        lua_settop(m_state, top);
+    }
+
+    /**
+     * \brief Runs a chunk, source or precompiled, held by a caller supplied
+     * buffer, which lua reads in place without copying it
+     */
+    void run_buffer(const char* data,
+                    std::size_t size,
+                    const std::string& chunk_name = "=buffer") const
+    {
+        int top = lua_gettop(m_state);
+        buffer_reader reader{data, size};
+        if (reader.load(m_state, chunk_name.c_str()) != 0 ||
+            lua_pcall(m_state, 0, 0, 0) != 0) {
+            std::string error_message = lua_tostring(m_state, -1);
+            lua_settop(m_state, top);
+            error(error_message);
+            return;
+        }
+        lua_settop(m_state, top);
+    }
+
+    /**
+     * \brief Runs the lua code with env as its environment, the globals it
+     * assigns, functions included, are stored in env instead of the globals of
+     * the state
+     */
+    void operator()(const std::string& lua_code, environment& env) const
+    {
+        if (!env.belongs_to(m_state)) {
+            error(error_info{error_kind::invalid_environment, m_fileName}.message(),
+                  error_kind::invalid_environment);
+            return;
+        }
+        int top = lua_gettop(m_state);
+        bool failed = luaL_loadstring(m_state, lua_code.c_str()) != 0;
+        if (!failed) {
+            env.push();
+            interface::set_environment(m_state, -2);
+            failed = lua_pcall(m_state, 0, 0, 0) != 0;
+        }
+        if (failed) {
+            std::string error_message = lua_tostring(m_state, -1);
+            lua_settop(m_state, top);
+            error(error_message);
+            return;
+        }
+        lua_settop(m_state, top);
+    }
+
+    /**
+     * \brief Hands out an environment in which code can run isolated from the
+     * other executions hosted by this state
+     * \sa environment
+     */
+    environment acquire_environment() const { return environment::acquire(m_state); }
+
     var_ref operator[](const std::string& name) const { return var_ref{m_state, name}; }
 
-    void open_std() const { state::open_std(m_fileName); }
+    /**
+     * \brief Creates a script on a lua state of its own, holding a copy of the
+     * globals of this one, without running the lua file again
+     * \note Meant to give every tenant an isolated state initialized from a
+     * warmed-up template, at a fraction of the cost of opening the file. The
+     * globals are captured on the first clone, see state::clone for what is
+     * copied and refresh_template to capture them again.
+     */
+    script clone() const { return script{m_fileName, state::clone(m_state)}; }
+
+    /**
+     * \brief Makes the next clone capture the current globals of this script,
+     * instead of the ones captured by the previous clones
+     */
+    void refresh_template() const { state::release_template(m_state); }
+
+    /**
+     * \brief Snapshot of the call counters and latency histograms of every lua
+     * function called through var_ref and of every registered C++ callable
+     * \note The statistics are collected only when the library is compiled with
+     * LUABZ_ENABLE_INSTRUMENTATION, they are discarded when the script is closed
+     */
+    std::string dump_metrics(metrics_format format = metrics_format::text) const
+    {
+        return metrics::dump(m_state, format);
+    }
+
+    /**
+     * \brief Control of the garbage collector of the lua state, e.g. to run
+     * the collection in the idle gaps of an event loop
+     * \sa garbage_collector
+     */
+    garbage_collector gc() const { return garbage_collector{m_state}; }
+
+    void open_std() const
+    {
+        if (m_ownsState) {
+            state::open_libraries(m_state);
+        } else {
+            state::open_std(m_fileName);
+        }
+    }
+
+  private:
+    /// Takes ownership of a lua state generated by state::create or state::clone
+    script(const std::string& file, lua_State* owned_state)
+      : m_fileName{file}, m_state{owned_state}, m_isStateActive{true}, m_ownsState{true}
+    {
+    }
+
+    lua_State* acquire_state(const std::string& file_name, bool load_lua_std) const
+    {
+        return m_ownsState ? state::create(file_name, load_lua_std)
+                           : state::get(file_name, load_lua_std);
+    }
+
+    /// Detaches the object from its lua state without closing it
+    void release() noexcept
+    {
+        m_state = nullptr;
+        m_isStateActive = false;
+        m_ownsState = false;
+    }
 };
 }  // namespace luabz
\ No newline at end of file
@@ -0,0 +1,388 @@
+#pragma once
+#include "interface.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <lua.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace luabz
+{
+/// How a serializer encodes functions
+enum class function_encoding {
+    /// Functions are encoded as nil
+    skip,
+    /// Lua functions without upvalues, apart from _ENV, are encoded as their bytecode
+    bytecode
+};
+
+/**
+ * \brief Compact binary encoding of lua values, used to move values between
+ * independent lua states without converting them to C++ types
+ *
+ * Supports nil, booleans, numbers, strings and tables. Every value starts
+ * with a one byte tag, integers are zigzag varints, numbers are the 8 bytes
+ * of the double in native byte order and strings are a varint length followed
+ * by the bytes. A table is its array size hint, its key/value pairs and an end
+ * tag. A table met again, through a cycle or a shared reference, is encoded
+ * as a back reference, so the decoded value has the same shape. \n
+ * The buffer is reused between encodings, a serializer kept around doesn't
+ * allocate once it has grown to the size of the largest value.
+ * \note Userdata, threads and, unless function_encoding::bytecode is
+ * requested, functions cannot be moved between states, they are encoded as nil
+ * and table pairs containing them are skipped. Bytecode is loaded without
+ * verification, a serializer encoding functions must only decode buffers it
+ * produced itself.
+ */
+class serializer
+{
+  public:
+    serializer() = default;
+
+    explicit serializer(function_encoding functions) : m_functions{functions} {}
+
+    /// Maximum depth of nested tables, deeper tables are encoded as nil
+    static constexpr std::size_t max_depth = 128;
+
+    /**
+     * \brief Encodes the value at index of state, replacing the previous
+     * content of the buffer
+     */
+    void encode(lua_State* state, int index)
+    {
+        m_buffer.clear();
+        m_tables.clear();
+        encode_value(state, interface::absolute_index(state, index), 0);
+    }
+
+    /**
+     * \brief Pushes onto state the value held by the buffer
+     * \return false, leaving the stack unchanged, when the buffer is malformed
+     */
+    bool decode(lua_State* state) const
+    {
+        int top = lua_gettop(state);
+        // Tables decoded so far, indexed by their back reference id
+        lua_newtable(state);
+        decoder reader{state, top + 1, m_buffer.data(), m_buffer.data() + m_buffer.size(),
+                       m_functions};
+        if (!reader.decode_value(0) || reader.m_position != reader.m_end) {
+            lua_settop(state, top);
+            return false;
+        }
+        lua_remove(state, top + 1);
+        return true;
+    }
+
+    /**
+     * \brief Copies the value at index of from onto the top of to
+     */
+    void transfer(lua_State* from, int index, lua_State* to)
+    {
+        encode(from, index);
+        if (!decode(to)) {
+            lua_pushnil(to);
+        }
+    }
+
+    const std::vector<char>& buffer() const { return m_buffer; }
+
+    /// Replaces the buffer, e.g. with bytes encoded by another serializer
+    void assign(const char* data, std::size_t size) { m_buffer.assign(data, data + size); }
+
+  private:
+    enum tag : unsigned char {
+        nil_tag,
+        false_tag,
+        true_tag,
+        integer_tag,
+        number_tag,
+        string_tag,
+        table_tag,
+        table_end_tag,
+        reference_tag,
+        function_tag
+    };
+
+    bool is_encodable(lua_State* state, int index) const
+    {
+        int type = lua_type(state, index);
+        return type == LUA_TNIL || type == LUA_TBOOLEAN || type == LUA_TNUMBER ||
+               type == LUA_TSTRING || type == LUA_TTABLE || is_dumpable(state, index);
+    }
+
+    /// Whether the value at index is a function whose bytecode can be encoded
+    bool is_dumpable(lua_State* state, int index) const
+    {
+        if (m_functions != function_encoding::bytecode || lua_type(state, index) != LUA_TFUNCTION ||
+            lua_iscfunction(state, index) != 0) {
+            return false;
+        }
+        const char* upvalue = lua_getupvalue(state, index, 1);
+        if (upvalue == nullptr) {
+            return true;
+        }
+        lua_pop(state, 1);
+#if LUABZ_LUA_VERSION >= 502
+        // The first upvalue of a loaded chunk is set to the globals of the new state
+        if (std::strcmp(upvalue, "_ENV") != 0) {
+            return false;
+        }
+        if (lua_getupvalue(state, index, 2) == nullptr) {
+            return true;
+        }
+        lua_pop(state, 1);
+#endif
+        return false;
+    }
+
+    void write_byte(unsigned char byte) { m_buffer.push_back(static_cast<char>(byte)); }
+
+    void write_varint(std::uint64_t number)
+    {
+        while (number >= 0x80) {
+            write_byte(static_cast<unsigned char>(number | 0x80));
+            number >>= 7;
+        }
+        write_byte(static_cast<unsigned char>(number));
+    }
+
+    void encode_number(lua_State* state, int index)
+    {
+#ifdef LUABZ_LUA_NATIVE_INTEGERS
+        if (lua_isinteger(state, index)) {
+            encode_integer(static_cast<std::int64_t>(lua_tointeger(state, index)));
+            return;
+        }
+#endif
+        lua_Number number = lua_tonumber(state, index);
+#ifndef LUABZ_LUA_NATIVE_INTEGERS
+        // Integral doubles are the common case on 5.1 and are much shorter as varints
+        if (std::floor(number) == number && std::fabs(number) < 9.2e18) {
+            encode_integer(static_cast<std::int64_t>(number));
+            return;
+        }
+#endif
+        double raw = static_cast<double>(number);
+        char bytes[sizeof(double)];
+        std::memcpy(bytes, &raw, sizeof(double));
+        write_byte(number_tag);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(double));
+    }
+
+    void encode_integer(std::int64_t number)
+    {
+        write_byte(integer_tag);
+        auto bits = static_cast<std::uint64_t>(number);
+        write_varint((bits << 1) ^ (number < 0 ? ~std::uint64_t{0} : 0));
+    }
+
+    void encode_value(lua_State* state, int index, std::size_t depth)
+    {
+        switch (lua_type(state, index)) {
+            case LUA_TBOOLEAN:
+                write_byte(lua_toboolean(state, index) != 0 ? true_tag : false_tag);
+                break;
+            case LUA_TNUMBER:
+                encode_number(state, index);
+                break;
+            case LUA_TSTRING: {
+                std::size_t size = 0;
+                const char* text = lua_tolstring(state, index, &size);
+                write_byte(string_tag);
+                write_varint(size);
+                m_buffer.insert(m_buffer.end(), text, text + size);
+                break;
+            }
+            case LUA_TTABLE:
+                encode_table(state, index, depth);
+                break;
+            case LUA_TFUNCTION:
+                encode_function(state, index);
+                break;
+            default:
+                write_byte(nil_tag);
+                break;
+        }
+    }
+
+    void encode_function(lua_State* state, int index)
+    {
+        m_bytecode.clear();
+        bool dumped = false;
+        if (is_dumpable(state, index) && lua_checkstack(state, 1) != 0) {
+            lua_pushvalue(state, index);
+            dumped = interface::dump_function(state, m_bytecode);
+            lua_pop(state, 1);
+        }
+        if (!dumped) {
+            write_byte(nil_tag);
+            return;
+        }
+        write_byte(function_tag);
+        write_varint(m_bytecode.size());
+        m_buffer.insert(m_buffer.end(), m_bytecode.begin(), m_bytecode.end());
+    }
+
+    void encode_table(lua_State* state, int index, std::size_t depth)
+    {
+        const void* table = lua_topointer(state, index);
+        auto known = m_tables.find(table);
+        if (known != m_tables.end()) {
+            write_byte(reference_tag);
+            write_varint(known->second);
+            return;
+        }
+        if (depth >= max_depth || lua_checkstack(state, 2) == 0) {
+            write_byte(nil_tag);
+            return;
+        }
+        auto id = static_cast<std::uint32_t>(m_tables.size());
+        m_tables.emplace(table, id);
+        write_byte(table_tag);
+        write_varint(interface::raw_length(state, index));
+        lua_pushnil(state);
+        while (lua_next(state, index) != 0) {
+            int top = lua_gettop(state);
+            if (is_encodable(state, top - 1) && is_encodable(state, top)) {
+                encode_value(state, top - 1, depth + 1);
+                encode_value(state, top, depth + 1);
+            }
+            lua_pop(state, 1);
+        }
+        write_byte(table_end_tag);
+    }
+
+    struct decoder {
+        lua_State* m_state;
+        int m_tablesIndex;
+        const char* m_position;
+        const char* m_end;
+        function_encoding m_functions;
+        int m_tablesCount = 0;
+
+        decoder(lua_State* state,
+                int tables_index,
+                const char* begin,
+                const char* end,
+                function_encoding functions)
+          : m_state{state},
+            m_tablesIndex{tables_index},
+            m_position{begin},
+            m_end{end},
+            m_functions{functions}
+        {
+        }
+
+        bool read_varint(std::uint64_t& number)
+        {
+            number = 0;
+            for (unsigned int shift = 0; shift < 64 && m_position != m_end; shift += 7) {
+                auto byte = static_cast<unsigned char>(*m_position++);
+                number |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool decode_value(std::size_t depth)
+        {
+            if (m_position == m_end || lua_checkstack(m_state, 3) == 0) {
+                return false;
+            }
+            auto value_tag = static_cast<tag>(static_cast<unsigned char>(*m_position++));
+            std::uint64_t number = 0;
+            switch (value_tag) {
+                case nil_tag:
+                    lua_pushnil(m_state);
+                    return true;
+                case false_tag:
+                case true_tag:
+                    lua_pushboolean(m_state, value_tag == true_tag ? 1 : 0);
+                    return true;
+                case integer_tag: {
+                    if (!read_varint(number)) {
+                        return false;
+                    }
+                    auto decoded = static_cast<std::int64_t>((number >> 1) ^ (~(number & 1) + 1));
+                    lua_pushinteger(m_state, static_cast<lua_Integer>(decoded));
+                    return true;
+                }
+                case number_tag: {
+                    if (static_cast<std::size_t>(m_end - m_position) < sizeof(double)) {
+                        return false;
+                    }
+                    double raw = 0.0;
+                    std::memcpy(&raw, m_position, sizeof(double));
+                    m_position += sizeof(double);
+                    lua_pushnumber(m_state, static_cast<lua_Number>(raw));
+                    return true;
+                }
+                case string_tag:
+                    if (!read_varint(number) ||
+                        number > static_cast<std::uint64_t>(m_end - m_position)) {
+                        return false;
+                    }
+                    lua_pushlstring(m_state, m_position, static_cast<std::size_t>(number));
+                    m_position += number;
+                    return true;
+                case table_tag:
+                    return depth < max_depth && read_varint(number) && decode_table(number, depth);
+                case reference_tag:
+                    if (!read_varint(number) ||
+                        number >= static_cast<std::uint64_t>(m_tablesCount)) {
+                        return false;
+                    }
+                    lua_rawgeti(m_state, m_tablesIndex, static_cast<int>(number + 1));
+                    return true;
+                case function_tag:
+                    if (m_functions != function_encoding::bytecode || !read_varint(number) ||
+                        number > static_cast<std::uint64_t>(m_end - m_position) ||
+                        interface::load_bytecode(m_state, m_position,
+                                                 static_cast<std::size_t>(number), "=luabz") != 0) {
+                        return false;
+                    }
+                    m_position += number;
+                    return true;
+                case table_end_tag:
+                    break;
+            }
+            return false;
+        }
+
+        bool decode_table(std::uint64_t array_size, std::size_t depth)
+        {
+            int array_hint = array_size < (1U << 24) ? static_cast<int>(array_size) : 0;
+            lua_createtable(m_state, array_hint, 0);
+            lua_pushvalue(m_state, -1);
+            lua_rawseti(m_state, m_tablesIndex, ++m_tablesCount);
+            while (m_position != m_end &&
+                   static_cast<unsigned char>(*m_position) != table_end_tag) {
+                if (!decode_value(depth + 1) || !decode_value(depth + 1)) {
+                    return false;
+                }
+                if (lua_isnil(m_state, -2) || lua_isnil(m_state, -1)) {
+                    lua_pop(m_state, 2);
+                    continue;
+                }
+                lua_rawset(m_state, -3);
+            }
+            if (m_position == m_end) {
+                return false;
+            }
+            ++m_position;
+            return true;
+        }
+    };
+
+    function_encoding m_functions = function_encoding::skip;
+    std::vector<char> m_buffer{};
+    /// Scratch space for the bytecode of the function being encoded
+    std::vector<char> m_bytecode{};
+    std::unordered_map<const void*, std::uint32_t> m_tables{};
+};
+}  // namespace luabz
@@ -0,0 +1,441 @@
+#pragma once
+#include "interface.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <lua.hpp>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace luabz
+{
+enum class snapshot_type : std::uint8_t { boolean, integer, number, string };
+
+/**
+ * \brief Scalar stored by a snapshot
+ * \note Integers and numbers convert into each other, the other types are
+ * returned only when they match
+ */
+class snapshot_value
+{
+  public:
+    snapshot_type type() const { return m_type; }
+
+    bool to_bool() const { return m_boolean; }
+
+    long long to_integer() const
+    {
+        return m_type == snapshot_type::number ? static_cast<long long>(m_number) : m_integer;
+    }
+
+    double to_number() const
+    {
+        return m_type == snapshot_type::integer ? static_cast<double>(m_integer) : m_number;
+    }
+
+    /// Points into the snapshot, valid as long as the snapshot is alive
+    const char* data() const { return m_string; }
+
+    std::size_t size() const { return m_size; }
+
+    std::string to_string() const { return std::string(m_string, m_size); }
+
+    bool is_arithmetic() const
+    {
+        return m_type == snapshot_type::integer || m_type == snapshot_type::number;
+    }
+
+  private:
+    friend class snapshot;
+
+    snapshot_type m_type = snapshot_type::boolean;
+    union {
+        bool m_boolean;
+        long long m_integer;
+        double m_number = 0.0;
+    };
+    const char* m_string = nullptr;
+    std::size_t m_size = 0;
+};
+
+/**
+ * \brief Immutable flat copy of a lua table subtree, safe to be read
+ * concurrently by any number of threads without synchronization
+ *
+ * Every boolean, number and string reachable from the table is stored under
+ * its path, the string keys joined with '.' as in var_ref and the numeric keys
+ * in brackets, e.g. "db.port" or "servers[1]". A '.', a '[' or a '\\' inside a
+ * string key is escaped with a '\\', so the key "a.b" is stored as "a\\.b" and
+ * doesn't collide with the path of a = {b = ...}, nor the key "[1]" with the
+ * numeric key 1, see escape_key. Paths and strings are interned in a single
+ * contiguous arena and looked up through an open-addressing hash table with
+ * linear probing.
+ * \note Functions, userdata and keys which are neither strings nor numbers are
+ * skipped. Tables deeper than max_depth and tables containing themselves are
+ * not descended.
+ */
+class snapshot
+{
+  public:
+    snapshot() : m_slots(1, 0) {}
+
+    snapshot(const snapshot&) = delete;
+
+    snapshot& operator=(const snapshot&) = delete;
+
+    /**
+     * \brief Copies the table at index of state, the stack is left unchanged
+     */
+    static std::shared_ptr<const snapshot> from_table(lua_State* state,
+                                                      int index,
+                                                      std::size_t max_depth = 16)
+    {
+        auto result = std::make_shared<snapshot>();
+        builder table_builder{*result, state, max_depth};
+        table_builder.collect(interface::absolute_index(state, index), 0);
+        result->finalize();
+        return result;
+    }
+
+    /// Escapes a string key for a path, e.g. escape_key("a.b") is "a\\.b"
+    static std::string escape_key(const std::string& key)
+    {
+        std::string escaped;
+        append_escaped_key(escaped, key.data(), key.size());
+        return escaped;
+    }
+
+    std::size_t size() const { return m_entries.size(); }
+
+    bool empty() const { return m_entries.empty(); }
+
+    bool contains(const std::string& path) const { return find(path) != nullptr; }
+
+    /// Returns nullptr when path is not present
+    const snapshot_value* find(const char* path, std::size_t path_size) const
+    {
+        std::uint64_t path_hash = hash(path, path_size);
+        std::size_t mask = m_slots.size() - 1;
+        for (std::size_t slot = path_hash & mask;; slot = (slot + 1) & mask) {
+            std::uint32_t entry_index = m_slots[slot];
+            if (entry_index == 0) {
+                return nullptr;
+            }
+            const entry& candidate = m_entries[entry_index - 1];
+            if (candidate.hash == path_hash && candidate.path_size == path_size &&
+                std::memcmp(candidate.path, path, path_size) == 0) {
+                return &candidate.value;
+            }
+        }
+    }
+
+    const snapshot_value* find(const std::string& path) const
+    {
+        return find(path.data(), path.size());
+    }
+
+    /**
+     * \brief Returns the value at path converted to T, or default_value when
+     * path is missing or holds a value of another type
+     */
+    template <typename T>
+    T get(const std::string& path, T default_value) const
+    {
+        const snapshot_value* found = find(path);
+        if (found == nullptr) {
+            return default_value;
+        }
+        return convert(*found, std::move(default_value));
+    }
+
+  private:
+    struct entry {
+        std::uint64_t hash;
+        const char* path;
+        std::size_t path_size;
+        std::size_t path_offset;
+        std::size_t string_offset;
+        snapshot_value value;
+    };
+
+    class builder
+    {
+      public:
+        builder(snapshot& target, lua_State* state, std::size_t max_depth)
+          : m_target{target}, m_state{state}, m_maxDepth{max_depth}
+        {
+        }
+
+        void collect(int table_index, std::size_t depth)
+        {
+            m_ancestors.insert(lua_topointer(m_state, table_index));
+            lua_pushnil(m_state);
+            while (lua_next(m_state, table_index) != 0) {
+                std::size_t prefix_size = m_path.size();
+                if (append_key(-2)) {
+                    add_value(depth);
+                }
+                m_path.resize(prefix_size);
+                lua_pop(m_state, 1);
+            }
+            m_ancestors.erase(lua_topointer(m_state, table_index));
+        }
+
+      private:
+        /// Appends the key at index to the current path, copying it so lua_next isn't disturbed
+        bool append_key(int index)
+        {
+            int key_type = lua_type(m_state, index);
+            if (key_type == LUA_TSTRING) {
+                if (!m_path.empty()) {
+                    m_path += '.';
+                }
+                std::size_t key_size = 0;
+                const char* key = lua_tolstring(m_state, index, &key_size);
+                append_escaped_key(m_path, key, key_size);
+                return true;
+            }
+            if (key_type == LUA_TNUMBER) {
+                m_path += '[';
+                append_number_key(index);
+                m_path += ']';
+                return true;
+            }
+            return false;
+        }
+
+        void append_number_key(int index)
+        {
+            char buffer[32];
+#ifdef LUABZ_LUA_NATIVE_INTEGERS
+            if (lua_isinteger(m_state, index)) {
+                std::snprintf(buffer, sizeof(buffer), "%lld",
+                              static_cast<long long>(lua_tointeger(m_state, index)));
+                m_path += buffer;
+                return;
+            }
+#endif
+            lua_Number key = lua_tonumber(m_state, index);
+            // -2^63 <= key < 2^63, outside of it the cast to long long is undefined
+            if (std::floor(key) == key && key >= -9223372036854775808.0 &&
+                key < 9223372036854775808.0) {
+                std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(key));
+            } else {
+                std::snprintf(buffer, sizeof(buffer), "%.14g", key);
+            }
+            m_path += buffer;
+        }
+
+        void add_value(std::size_t depth)
+        {
+            snapshot_value stored;
+            switch (lua_type(m_state, -1)) {
+                case LUA_TBOOLEAN:
+                    stored.m_type = snapshot_type::boolean;
+                    stored.m_boolean = lua_toboolean(m_state, -1) != 0;
+                    m_target.add(m_path, stored);
+                    break;
+                case LUA_TNUMBER:
+#ifdef LUABZ_LUA_NATIVE_INTEGERS
+                    if (lua_isinteger(m_state, -1)) {
+                        stored.m_type = snapshot_type::integer;
+                        stored.m_integer = static_cast<long long>(lua_tointeger(m_state, -1));
+                        m_target.add(m_path, stored);
+                        break;
+                    }
+#endif
+                    stored.m_type = snapshot_type::number;
+                    stored.m_number = static_cast<double>(lua_tonumber(m_state, -1));
+                    m_target.add(m_path, stored);
+                    break;
+                case LUA_TSTRING: {
+                    std::size_t text_size = 0;
+                    const char* text = lua_tolstring(m_state, -1, &text_size);
+                    stored.m_type = snapshot_type::string;
+                    m_target.add(m_path, stored, text, text_size);
+                    break;
+                }
+                case LUA_TTABLE:
+                    if (depth + 1 < m_maxDepth &&
+                        m_ancestors.count(lua_topointer(m_state, -1)) == 0) {
+                        collect(lua_gettop(m_state), depth + 1);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        snapshot& m_target;
+        lua_State* m_state;
+        std::size_t m_maxDepth;
+        std::string m_path{};
+        std::unordered_set<const void*> m_ancestors{};
+    };
+
+    static void append_escaped_key(std::string& path, const char* key, std::size_t key_size)
+    {
+        for (std::size_t i = 0; i < key_size; ++i) {
+            if (key[i] == '.' || key[i] == '[' || key[i] == '\\') {
+                path += '\\';
+            }
+            path += key[i];
+        }
+    }
+
+    /// FNV-1a
+    static std::uint64_t hash(const char* data, std::size_t size)
+    {
+        std::uint64_t result = 14695981039346656037ULL;
+        for (std::size_t i = 0; i < size; ++i) {
+            result ^= static_cast<unsigned char>(data[i]);
+            result *= 1099511628211ULL;
+        }
+        return result;
+    }
+
+    void add(const std::string& path,
+             const snapshot_value& stored,
+             const char* text = nullptr,
+             std::size_t text_size = 0)
+    {
+        entry added{hash(path.data(), path.size()), nullptr, path.size(), m_arena.size(), 0,
+                    stored};
+        m_arena.insert(m_arena.end(), path.begin(), path.end());
+        added.string_offset = m_arena.size();
+        added.value.m_size = text_size;
+        m_arena.insert(m_arena.end(), text, text + text_size);
+        m_entries.push_back(added);
+    }
+
+    /// Resolves the arena offsets and builds the hash table, the snapshot is immutable afterwards
+    void finalize()
+    {
+        std::size_t capacity = 1;
+        while (capacity < m_entries.size() * 2) {
+            capacity <<= 1;
+        }
+        m_slots.assign(capacity, 0);
+        std::size_t mask = capacity - 1;
+        for (std::size_t i = 0; i < m_entries.size(); ++i) {
+            entry& current = m_entries[i];
+            current.path = m_arena.data() + current.path_offset;
+            if (current.value.m_type == snapshot_type::string) {
+                current.value.m_string = m_arena.data() + current.string_offset;
+            }
+            std::size_t slot = current.hash & mask;
+            while (m_slots[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            m_slots[slot] = static_cast<std::uint32_t>(i + 1);
+        }
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_same<T, bool>::value, T>::type convert(
+        const snapshot_value& found,
+        T default_value)
+    {
+        return found.type() == snapshot_type::boolean ? found.to_bool() : default_value;
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value,
+                                   T>::type
+    convert(const snapshot_value& found, T default_value)
+    {
+        return found.is_arithmetic() ? static_cast<T>(found.to_integer()) : default_value;
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value, T>::type convert(
+        const snapshot_value& found,
+        T default_value)
+    {
+        return found.is_arithmetic() ? static_cast<T>(found.to_number()) : default_value;
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_same<T, std::string>::value, T>::type convert(
+        const snapshot_value& found,
+        T default_value)
+    {
+        return found.type() == snapshot_type::string ? found.to_string() : default_value;
+    }
+
+    std::vector<char> m_arena{};
+    std::vector<entry> m_entries{};
+    /// Index + 1 of the entry stored in every slot, 0 marks an empty slot
+    std::vector<std::uint32_t> m_slots;
+};
+
+/**
+ * \brief Publishes the latest snapshot of a configuration, RCU style
+ * \note The writer builds a new snapshot and swaps the pointer, the readers
+ * keep the previous one alive until they refresh. Readers should go through
+ * snapshot_reader, which only touches the shared pointer when a new snapshot
+ * has been published.
+ */
+class snapshot_publisher
+{
+  public:
+    snapshot_publisher() : m_current{std::make_shared<const snapshot>()} {}
+
+    explicit snapshot_publisher(std::shared_ptr<const snapshot> initial)
+      : m_current{std::move(initial)}
+    {
+    }
+
+    void publish(std::shared_ptr<const snapshot> next)
+    {
+        std::atomic_store(&m_current, std::move(next));
+        m_version.fetch_add(1, std::memory_order_release);
+    }
+
+    std::shared_ptr<const snapshot> current() const { return std::atomic_load(&m_current); }
+
+    std::uint64_t version() const { return m_version.load(std::memory_order_acquire); }
+
+  private:
+    std::shared_ptr<const snapshot> m_current;
+    std::atomic<std::uint64_t> m_version{0};
+};
+
+/**
+ * \brief Per thread view of a snapshot_publisher
+ * \note get() costs a single atomic load while no new snapshot is published,
+ * the returned reference is valid until the next call to get()
+ */
+class snapshot_reader
+{
+  public:
+    explicit snapshot_reader(const snapshot_publisher& publisher)
+      : m_publisher{publisher},
+        m_version{publisher.version()},
+        m_snapshot{publisher.current()}
+    {
+    }
+
+    const snapshot& get()
+    {
+        std::uint64_t latest = m_publisher.version();
+        if (latest != m_version) {
+            m_snapshot = m_publisher.current();
+            m_version = latest;
+        }
+        return *m_snapshot;
+    }
+
+  private:
+    const snapshot_publisher& m_publisher;
+    std::uint64_t m_version;
+    std::shared_ptr<const snapshot> m_snapshot;
+};
+}  // namespace luabz
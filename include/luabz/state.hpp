@@ -1,14 +1,46 @@
 #pragma once
 #include "error.hpp"
+#include "interface.hpp"
+#include "modules.hpp"
+#include "reader.hpp"
+#include "serializer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
 #include <functional>
 #include <lua.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 namespace luabz
 {
+/**
+ * \brief Tag used to request a lua state which is not shared with the other
+ * scripts opened on the same file
+ */
+struct unique_state_t {
+};
+constexpr unique_state_t unique_state{};
+
 class state
 {
   public:
+    /**
+     * \brief Loads lua's std into state and installs the searcher of the
+     * module_registry
+     */
+    static void open_libraries(lua_State* state)
+    {
+        luaL_openlibs(state);
+        module_registry::install(state);
+    }
+
     /// Generates new lua_state to be used by script
     /**
      *
@@ -21,6 +53,7 @@ class state
     // TODO:Rename and split this shit
     static lua_State* get(const std::string& file_name, bool load_std = false)
     {
+        std::lock_guard<std::mutex> lock(get_registry_mutex());
         bool already_inserted =
             get_active_lua_states().find(file_name) != get_active_lua_states().end();
         if (already_inserted) {
@@ -29,49 +62,378 @@ class state
         return create_new_lua_state(file_name, load_std);
     }
 
+    /**
+     * \brief Generates a new lua_State which is not shared with any other script
+     * \note The returned lua state is owned by the caller and has to be released
+     * with destroy, it's never returned by get
+     */
+    static lua_State* create(const std::string& file_name, bool load_std = false)
+    {
+        return create_lua_state(file_name, load_std);
+    }
+
+    /**
+     * \brief Generates a new lua_State holding a copy of the global environment
+     * of a template state, without running its lua file again
+     *
+     * The globals of the template are captured the first time it's cloned,
+     * encoded once and decoded into every clone, until release_template is
+     * called. Tables, strings, numbers, booleans and lua functions without
+     * upvalues other than _ENV are copied, lua functions as bytecode. The lua
+     * std is loaded in the clone when the template has it, modules in
+     * package.loaded are copied as well.
+     * \note The returned lua state is owned by the caller and has to be released
+     * with destroy. C++ functions and lua functions with upvalues are not
+     * copied, they have to be registered or defined again. When the template
+     * has the lua std its globals named as the std ones are not copied.
+     */
+    static lua_State* clone(lua_State* source)
+    {
+        std::shared_ptr<const template_image> image;
+        {
+            std::lock_guard<std::mutex> lock(get_registry_mutex());
+            auto found = get_template_images().find(source);
+            if (found != get_template_images().end()) {
+                image = found->second;
+            }
+        }
+        if (image == nullptr) {
+            image = capture_template(source);
+            std::lock_guard<std::mutex> lock(get_registry_mutex());
+            get_template_images()[source] = image;
+        }
+        lua_State* state = luaL_newstate();
+        if (state == nullptr) {
+            error("Cannot create a new lua_State");
+            return state;
+        }
+        if (image->load_std) {
+            open_libraries(state);
+        }
+        if (!image->fields.decode(state)) {
+            error("Cannot clone the lua_State, its image is malformed");
+            return state;
+        }
+        int image_index = lua_gettop(state);
+        interface::push_globals(state);
+        merge_fields(state, image_index, 1, lua_gettop(state));
+        lua_pop(state, 1);
+        if (image->load_std && push_loaded_modules(state)) {
+            merge_fields(state, image_index, 2, lua_gettop(state));
+        }
+        lua_settop(state, 0);
+        return state;
+    }
+
+    /**
+     * \brief Compiles lua files in parallel, each on a scratch lua state of a
+     * worker thread, and keeps their bytecode for the states created afterwards
+     *
+     * get, create and the scripts opened on a preloaded file load its bytecode
+     * instead of reading and parsing the file, so opening many scripts is
+     * bounded by the compilation of the largest one instead of the sum of all
+     * of them. The calling thread takes part in the compilation.
+     * \note The bytecode is kept until discard_preloaded is called, later
+     * changes of the files are not seen. The files which cannot be compiled
+     * are reported through luabz::error once the others are kept, they're
+     * loaded from disk as usual.
+     * \return The number of files compiled
+     */
+    static std::size_t preload(const std::vector<std::string>& paths,
+                               std::size_t threads = std::thread::hardware_concurrency())
+    {
+        threads = std::max<std::size_t>(1, std::min(threads, paths.size()));
+        std::vector<std::string> bytecodes(paths.size());
+        std::vector<std::string> error_messages(paths.size());
+        std::atomic<std::size_t> next{0};
+        auto compile = [&] {
+            for (std::size_t i = next++; i < paths.size(); i = next++) {
+                error_messages[i] = compile_file(paths[i], bytecodes[i]);
+            }
+        };
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (std::size_t i = 1; i < threads; ++i) {
+            workers.emplace_back(compile);
+        }
+        compile();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        std::size_t compiled = 0;
+        std::string failures;
+        {
+            std::lock_guard<std::mutex> lock(get_preloaded_mutex());
+            for (std::size_t i = 0; i < paths.size(); ++i) {
+                if (!error_messages[i].empty()) {
+                    failures += (failures.empty() ? "" : "\n") + error_messages[i];
+                    continue;
+                }
+                get_preloaded_chunks()[paths[i]] =
+                    std::make_shared<const std::string>(std::move(bytecodes[i]));
+                ++compiled;
+            }
+        }
+        if (!failures.empty()) {
+            error("Cannot preload:\n" + failures);
+        }
+        return compiled;
+    }
+
+    /// Whether the bytecode of file_name has been kept by preload
+    static bool is_preloaded(const std::string& file_name)
+    {
+        return find_preloaded(file_name) != nullptr;
+    }
+
+    /// Discards the bytecode kept by preload, the files are read again
+    static void discard_preloaded()
+    {
+        std::lock_guard<std::mutex> lock(get_preloaded_mutex());
+        get_preloaded_chunks().clear();
+    }
+
+    /**
+     * \brief Discards the image captured from a template state, the next clone
+     * captures its globals again
+     */
+    static void release_template(lua_State* source)
+    {
+        std::lock_guard<std::mutex> lock(get_registry_mutex());
+        get_template_images().erase(source);
+    }
+
+    /**
+     * \brief Closes a lua state generated by create or clone
+     */
+    static void destroy(lua_State* state)
+    {
+        remove_cpp_registered_functions(state);
+        release_template(state);
+        lua_close(state);
+    }
+
     static void open_std(const std::string& file_name)
     {
-        lua_State* m_state = get_loaded_lua_state(file_name);
-        luaL_openlibs(m_state);
+        lua_State* m_state = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(get_registry_mutex());
+            m_state = get_loaded_lua_state(file_name);
+        }
+        open_libraries(m_state);
     }
 
     static void close(const std::string& file_name)
     {
+        std::lock_guard<std::mutex> lock(get_registry_mutex());
         lua_State* state = get_loaded_lua_state(file_name);
+        get_template_images().erase(state);
+        get_cpp_registered_functions().erase(state);
         lua_close(state);
         state = nullptr;
         get_active_lua_states()[file_name] = state;
         get_active_lua_states().erase(file_name);
     }
 
-    static std::function<int(lua_State*)> get_cpp_registered_function(std::size_t index)
+    /// Releases the C++ functions registered in state
+    static void remove_cpp_registered_functions(lua_State* state)
     {
-        return get_all_registered_functions().at(index);
+        std::lock_guard<std::mutex> lock(get_registry_mutex());
+        get_cpp_registered_functions().erase(state);
     }
 
-    static void remove_cpp_registered_functions(lua_State* state)
+    /**
+     * \brief Keeps f alive until the functions of state are removed, f
+     * returns its results count, or a negative value to raise the value on the
+     * top of the stack as a lua error
+     * \return The stored function, its address stays valid while other
+     * functions are registered, so lua can hold it as an upvalue and call it
+     * without taking any lock
+     */
+    static const std::function<int(lua_State*)>* register_cpp_function(
+        lua_State* state,
+        std::function<int(lua_State*)>&& f)
     {
-        auto file_registered_functions = get_cpp_registered_functions(state);
-        file_registered_functions.clear();
+        std::lock_guard<std::mutex> lock(get_registry_mutex());
+        auto& state_functions = get_cpp_registered_functions()[state];
+        state_functions.push_back(std::move(f));
+        return &state_functions.back();
     }
-    static std::size_t register_cpp_function(lua_State* state, std::function<int(lua_State*)>&& f)
+
+  private:
+    /// Globals of a template state, encoded once and decoded into every clone
+    struct template_image {
+        /// A table holding the copied globals at 1 and the copied package.loaded at 2
+        serializer fields{function_encoding::bytecode};
+        bool load_std = false;
+    };
+
+    /// Names of the globals and of the modules defined by the lua std
+    struct std_names {
+        std::unordered_set<std::string> globals;
+        std::unordered_set<std::string> modules;
+    };
+
+    static const std_names& get_std_names()
     {
-        get_all_registered_functions().emplace_back(f);
-        auto inserted_function_position = get_all_registered_functions().size() - 1;
-        get_cpp_registered_functions(state).push_back(inserted_function_position);
-        return inserted_function_position;
+        static const std_names names = [] {
+            std_names result;
+            lua_State* state = luaL_newstate();
+            luaL_openlibs(state);
+            interface::push_globals(state);
+            collect_string_keys(state, lua_gettop(state), result.globals);
+            if (push_loaded_modules(state)) {
+                collect_string_keys(state, lua_gettop(state), result.modules);
+            }
+            lua_close(state);
+            return result;
+        }();
+        return names;
     }
 
-  private:
-    static std::vector<int>& get_cpp_registered_functions(lua_State* state)
+    static void collect_string_keys(lua_State* state,
+                                    int index,
+                                    std::unordered_set<std::string>& keys)
+    {
+        lua_pushnil(state);
+        while (lua_next(state, index) != 0) {
+            if (lua_type(state, -2) == LUA_TSTRING) {
+                std::size_t size = 0;
+                const char* key = lua_tolstring(state, -2, &size);
+                keys.emplace(key, size);
+            }
+            lua_pop(state, 1);
+        }
+    }
+
+    /// Pushes package.loaded, returns false, pushing nothing, when it isn't a table
+    static bool push_loaded_modules(lua_State* state)
+    {
+        int top = lua_gettop(state);
+        interface::get_global(state, "package");
+        if (lua_istable(state, -1)) {
+            lua_getfield(state, -1, "loaded");
+            if (lua_istable(state, -1)) {
+                lua_remove(state, top + 1);
+                return true;
+            }
+        }
+        lua_settop(state, top);
+        return false;
+    }
+
+    /**
+     * \brief Copies into a new table the fields of the table at index whose
+     * key isn't in skipped, and stores it in the image table at slot
+     */
+    static void copy_fields(lua_State* state,
+                            int index,
+                            const std::unordered_set<std::string>& skipped,
+                            int image_index,
+                            int slot)
+    {
+        lua_newtable(state);
+        lua_pushnil(state);
+        while (lua_next(state, index) != 0) {
+            bool is_skipped = false;
+            if (lua_type(state, -2) == LUA_TSTRING) {
+                std::size_t size = 0;
+                const char* key = lua_tolstring(state, -2, &size);
+                is_skipped = skipped.count(std::string(key, size)) != 0;
+            }
+            if (is_skipped) {
+                lua_pop(state, 1);
+                continue;
+            }
+            lua_pushvalue(state, -2);
+            lua_insert(state, -2);
+            lua_rawset(state, -4);
+        }
+        lua_rawseti(state, image_index, slot);
+    }
+
+    /// Sets in the table at target_index the fields of the table stored at slot of the image
+    static void merge_fields(lua_State* state, int image_index, int slot, int target_index)
+    {
+        lua_rawgeti(state, image_index, slot);
+        int fields_index = lua_gettop(state);
+        if (lua_istable(state, fields_index)) {
+            lua_pushnil(state);
+            while (lua_next(state, fields_index) != 0) {
+                lua_pushvalue(state, -2);
+                lua_insert(state, -2);
+                lua_rawset(state, target_index);
+            }
+        }
+        lua_pop(state, 1);
+    }
+
+    static std::shared_ptr<const template_image> capture_template(lua_State* source)
+    {
+        static const std::unordered_set<std::string> nothing_skipped{};
+        auto image = std::make_shared<template_image>();
+        int top = lua_gettop(source);
+        lua_createtable(source, 2, 0);
+        int image_index = top + 1;
+        // Without the lua std none of the globals comes from it
+        image->load_std = push_loaded_modules(source);
+        if (image->load_std) {
+            copy_fields(source, lua_gettop(source), get_std_names().modules, image_index, 2);
+            lua_pop(source, 1);
+        }
+        interface::push_globals(source);
+        copy_fields(source, lua_gettop(source),
+                    image->load_std ? get_std_names().globals : nothing_skipped, image_index, 1);
+        image->fields.encode(source, image_index);
+        lua_settop(source, top);
+        return image;
+    }
+
+    static std::unordered_map<lua_State*, std::shared_ptr<const template_image>>&
+    get_template_images()
+    {
+        static std::unordered_map<lua_State*, std::shared_ptr<const template_image>> images{};
+        return images;
+    }
+
+    static std::shared_ptr<const std::string> find_preloaded(const std::string& file_name)
     {
-        static std::unordered_map<lua_State*, std::vector<int>> cpp_registered_functions{};
-        return cpp_registered_functions[state];
+        std::lock_guard<std::mutex> lock(get_preloaded_mutex());
+        auto found = get_preloaded_chunks().find(file_name);
+        return found != get_preloaded_chunks().end() ? found->second : nullptr;
     }
-    static std::vector<std::function<int(lua_State*)>>& get_all_registered_functions()
+
+    static std::unordered_map<std::string, std::shared_ptr<const std::string>>&
+    get_preloaded_chunks()
     {
-        static std::vector<std::function<int(lua_State*)>> registered_functions{};
-        return registered_functions;
+        static std::unordered_map<std::string, std::shared_ptr<const std::string>> chunks{};
+        return chunks;
+    }
+
+    /**
+     * \brief Guards the bytecode kept by preload, apart from the registry
+     * mutex which is held by get while the file runs
+     */
+    static std::mutex& get_preloaded_mutex()
+    {
+        static std::mutex preloaded_mutex{};
+        return preloaded_mutex;
+    }
+
+    /// Guards the collections of active lua states and registered functions
+    static std::mutex& get_registry_mutex()
+    {
+        static std::mutex registry_mutex{};
+        return registry_mutex;
+    }
+
+    /// The functions of every state, a deque so push_back doesn't move them
+    static std::unordered_map<lua_State*, std::deque<std::function<int(lua_State*)>>>&
+    get_cpp_registered_functions()
+    {
+        static std::unordered_map<lua_State*, std::deque<std::function<int(lua_State*)>>>
+            cpp_registered_functions{};
+        return cpp_registered_functions;
     }
     /**
      * \brief Retrieves the lua script associated with file_name from
@@ -83,21 +445,52 @@ class state
     }
 
     static lua_State* create_new_lua_state(const std::string& file_name, bool load_std)
+    {
+        lua_State* state = create_lua_state(file_name, load_std);
+        get_active_lua_states()[file_name] = state;
+        return state;
+    }
+
+    static lua_State* create_lua_state(const std::string& file_name, bool load_std)
     {
         lua_State* state = luaL_newstate();
         if (state == nullptr) {
             error("Cannot create a new lua_State");
         }
-        if (luaL_dofile(state, file_name.c_str())) {
-            error(lua_tostring(state, -1));
-        }
+        // The std is loaded first, so the file can require its modules
         if (load_std) {
-            luaL_openlibs(state);
+            open_libraries(state);
+        }
+        if (run_main_chunk(state, file_name) != 0) {
+            error(lua_tostring(state, -1));
+            lua_pop(state, 1);
         }
-        get_active_lua_states()[file_name] = state;
         return state;
     }
 
+    /// Runs the lua file, or the registered module when file_name comes from from_module
+    static int run_main_chunk(lua_State* state, const std::string& file_name)
+    {
+        std::string module_prefix = module_registry::prefix;
+        bool is_module = file_name.compare(0, module_prefix.size(), module_prefix) == 0;
+        int status = is_module
+                         ? module_registry::load(state, file_name.substr(module_prefix.size()))
+                         : load_source(state, file_name);
+        return status != 0 ? status : lua_pcall(state, 0, LUA_MULTRET, 0);
+    }
+
+    /// Loads the bytecode kept by preload, otherwise the file through mmap, in a single piece
+    static int load_source(lua_State* state, const std::string& file_name)
+    {
+        std::shared_ptr<const std::string> bytecode = find_preloaded(file_name);
+        if (bytecode == nullptr) {
+            return load_file(state, file_name);
+        }
+        std::string chunk_name = "@" + file_name;
+        buffer_reader reader{bytecode->data(), bytecode->size()};
+        return reader.load(state, chunk_name.c_str());
+    }
+
     static std::unordered_map<std::string, lua_State*>& get_active_lua_states()
     {
         static std::unordered_map<std::string, lua_State*> active_lua_states{};
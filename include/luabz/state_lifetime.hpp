@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <lua.hpp>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace luabz
+{
+/**
+ * \brief Tells the objects holding on to a lua state, e.g. environment and
+ * event_dispatcher, whether the state is still open
+ *
+ * Every object watching a state shares its flag, which is cleared when the
+ * lifetime of the state ends, so an object outliving the state knows it must
+ * not touch it anymore.
+ * \note script::close ends the lifetime of its state
+ */
+class state_lifetime
+{
+  public:
+    using flag = std::shared_ptr<const std::atomic<bool>>;
+
+    /// The flag of state, true until end is called for it
+    static flag watch(lua_State* state)
+    {
+        std::lock_guard<std::mutex> lock(get_mutex());
+        auto& state_flag = get_flags()[state];
+        if (state_flag == nullptr) {
+            state_flag = std::make_shared<std::atomic<bool>>(true);
+        }
+        return state_flag;
+    }
+
+    /// Clears the flag of state, called before the state is closed
+    static void end(lua_State* state)
+    {
+        std::lock_guard<std::mutex> lock(get_mutex());
+        auto found = get_flags().find(state);
+        if (found != get_flags().end()) {
+            *found->second = false;
+            get_flags().erase(found);
+        }
+    }
+
+  private:
+    static std::mutex& get_mutex()
+    {
+        static std::mutex lifetime_mutex{};
+        return lifetime_mutex;
+    }
+
+    static std::unordered_map<lua_State*, std::shared_ptr<std::atomic<bool>>>& get_flags()
+    {
+        static std::unordered_map<lua_State*, std::shared_ptr<std::atomic<bool>>> flags{};
+        return flags;
+    }
+};
+}  // namespace luabz
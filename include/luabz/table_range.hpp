@@ -0,0 +1,183 @@
+#pragma once
+#include "error.hpp"
+#include "interface.hpp"
+#include "value.hpp"
+#include "var_loader.hpp"
+#include <lua.hpp>
+#include <string>
+
+namespace luabz
+{
+/**
+ * \brief Proxy of a value sitting on the lua stack, converted on request
+ * through luabz::value
+ * \note Valid only while the value stays on the stack, e.g. until the
+ * iterator of a table_range is incremented
+ */
+class stack_value
+{
+  public:
+    /**
+     * \param copy_on_read Converts a copy of the value, used for the keys of a
+     * traversal which lua_tolstring would otherwise change from numbers into
+     * strings, confusing lua_next
+     */
+    stack_value(lua_State* state, int index, bool copy_on_read = false)
+      : m_state{state}, m_index{index}, m_copyOnRead{copy_on_read}
+    {
+    }
+
+    /// The lua type of the value, e.g. LUA_TSTRING
+    int type() const { return lua_type(m_state, m_index); }
+
+    /**
+     * \pre The specialization of luabz::value with type T must provide "is"
+     */
+    template <typename T>
+    bool is() const
+    {
+        return value<T>::is(m_state, m_index);
+    }
+
+    template <typename T, typename Policy = checked>
+    T get(Policy policy = Policy{}) const
+    {
+        if (!m_copyOnRead) {
+            return value<T>::get(m_state, m_index, policy);
+        }
+        lua_pushvalue(m_state, m_index);
+        T result = value<T>::get(m_state, lua_gettop(m_state), policy);
+        lua_pop(m_state, 1);
+        return result;
+    }
+
+  private:
+    lua_State* m_state;
+
+    int m_index;
+
+    bool m_copyOnRead;
+};
+
+/// Key and value of the current step of a table traversal
+struct table_entry {
+    stack_value key;
+    stack_value value;
+};
+
+/**
+ * \brief Single pass traversal of a lua table with lua_next
+ *
+ * The table is pushed once by the constructor and every step reads the key
+ * and the value straight from the stack, no variable name is built nor looked
+ * up. The order of the pairs is the order of lua_next. \n
+ * The destructor restores the stack, so a traversal can be left at any step.
+ * \note Only one iterator of a range can be used at a time, begin() restarts
+ * the traversal. The stack has to be balanced between two steps and the table
+ * must not get new keys during the traversal.
+ */
+class table_range
+{
+  public:
+    class iterator
+    {
+      public:
+        iterator(lua_State* state, int table_index, bool is_end)
+          : m_state{state}, m_tableIndex{table_index}, m_isEnd{is_end}
+        {
+        }
+
+        table_entry operator*() const
+        {
+            return table_entry{stack_value{m_state, m_tableIndex + 1, true},
+                               stack_value{m_state, m_tableIndex + 2}};
+        }
+
+        iterator& operator++()
+        {
+            lua_settop(m_state, m_tableIndex + 1);
+            advance();
+            return *this;
+        }
+
+        bool operator==(const iterator& rhs) const { return m_isEnd == rhs.m_isEnd; }
+
+        bool operator!=(const iterator& rhs) const { return m_isEnd != rhs.m_isEnd; }
+
+      private:
+        friend class table_range;
+
+        void advance()
+        {
+            if (lua_next(m_state, m_tableIndex) == 0) {
+                m_isEnd = true;
+            }
+        }
+
+        lua_State* m_state;
+
+        int m_tableIndex;
+
+        bool m_isEnd;
+    };
+
+    table_range(lua_State* state, const std::string& variable_name)
+      : m_state{state}, m_initialTop{lua_gettop(state)}
+    {
+        // The placeholder keeps the table on the stack after the loader restores it
+        lua_pushnil(m_state);
+        {
+            // A parent which is not a table is reported below, with the stack restored
+            var_loader loader(m_state, variable_name, false);
+            lua_replace(m_state, m_initialTop + 1);
+        }
+        if (!lua_istable(m_state, m_initialTop + 1)) {
+            lua_settop(m_state, m_initialTop);
+            m_state = nullptr;
+            error(variable_name + " is not a table, and cannot be traversed",
+                  error_kind::not_a_table);
+        }
+    }
+
+    table_range(const table_range&) = delete;
+
+    table_range& operator=(const table_range&) = delete;
+
+    table_range(table_range&& rhs) noexcept
+      : m_state{rhs.m_state}, m_initialTop{rhs.m_initialTop}
+    {
+        rhs.m_state = nullptr;
+    }
+
+    table_range& operator=(table_range&&) = delete;
+
+    ~table_range()
+    {
+        if (m_state != nullptr) {
+            lua_settop(m_state, m_initialTop);
+        }
+    }
+
+    iterator begin()
+    {
+        if (m_state == nullptr) {
+            return end();
+        }
+        int table_index = m_initialTop + 1;
+        lua_settop(m_state, table_index);
+        lua_checkstack(m_state, 3);
+        lua_pushnil(m_state);
+        iterator first{m_state, table_index, false};
+        first.advance();
+        return first;
+    }
+
+    iterator end() const { return iterator{m_state, m_initialTop + 1, true}; }
+
+  private:
+    /// nullptr when the variable isn't a table or the range has been moved from
+    lua_State* m_state;
+
+    int m_initialTop;
+};
+}  // namespace luabz
@@ -0,0 +1,99 @@
+#pragma once
+#include "table_range.hpp"
+#include <cstddef>
+#include <lua.hpp>
+
+namespace luabz
+{
+/**
+ * \brief Base of the visitors accepted by var_ref::visit, every event is
+ * ignored unless the derived visitor hides it
+ *
+ * For every table, nested ones included, the visitor receives begin_table,
+ * then key followed either by the events of the nested table or by scalar for
+ * each pair, and finally end_table. Depth is 0 for the visited table.
+ * \note The events are dispatched statically, the methods don't need to be
+ * virtual. The stack_value arguments are valid only for the duration of the
+ * call.
+ */
+struct table_visitor {
+    void begin_table(std::size_t /*unused*/) {}
+    void key(const stack_value& /*unused*/) {}
+    void scalar(const stack_value& /*unused*/) {}
+    void end_table(std::size_t /*unused*/) {}
+};
+
+/**
+ * \brief Depth-first walk of a lua table with lua_next, streaming its content
+ * to a visitor as SAX-like events, without building any C++ container
+ *
+ * The walk allocates nothing per node and uses two stack slots per level, on
+ * top of a copy of the table pushed by walk. A table nested deeper than max_depth, or containing one of
+ * its ancestors, is passed to scalar instead of being walked, so its type is
+ * LUA_TTABLE.
+ * \sa table_visitor
+ */
+template <typename Visitor>
+class table_walker
+{
+  public:
+    table_walker(lua_State* state, Visitor& visitor, std::size_t max_depth)
+      : m_state{state}, m_visitor{visitor}, m_maxDepth{max_depth}
+    {
+    }
+
+    /**
+     * \brief Walks the table at table_index, the stack is left unchanged
+     * \note The table is copied to the top of the stack first, the levels
+     * below are found from it, so table_index may be any valid index
+     */
+    void walk(int table_index)
+    {
+        lua_pushvalue(m_state, table_index);
+        m_rootIndex = lua_gettop(m_state);
+        walk_table(m_rootIndex, 0);
+        lua_pop(m_state, 1);
+    }
+
+  private:
+    void walk_table(int table_index, std::size_t depth)
+    {
+        m_visitor.begin_table(depth);
+        lua_pushnil(m_state);
+        while (lua_next(m_state, table_index) != 0) {
+            int value_index = table_index + 2;
+            m_visitor.key(stack_value{m_state, value_index - 1, true});
+            if (is_walkable(value_index, depth + 1)) {
+                walk_table(value_index, depth + 1);
+            } else {
+                m_visitor.scalar(stack_value{m_state, value_index});
+            }
+            lua_settop(m_state, value_index - 1);
+        }
+        m_visitor.end_table(depth);
+    }
+
+    bool is_walkable(int value_index, std::size_t depth) const
+    {
+        if (!lua_istable(m_state, value_index) || depth >= m_maxDepth ||
+            lua_checkstack(m_state, 2) == 0) {
+            return false;
+        }
+        // The ancestors are the tables sitting every two slots from the root
+        for (int ancestor = m_rootIndex; ancestor < value_index; ancestor += 2) {
+            if (lua_rawequal(m_state, ancestor, value_index) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    lua_State* m_state;
+
+    Visitor& m_visitor;
+
+    std::size_t m_maxDepth;
+
+    int m_rootIndex = 0;
+};
+}  // namespace luabz
@@ -1,6 +1,11 @@
 #pragma once
 #include "interface.hpp"
 #include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+/// Defined when std::string_view can be read and inserted through luabz::value
+#define LUABZ_HAS_STRING_VIEW
+#endif
 namespace luabz
 {
 /**
@@ -9,7 +14,12 @@ namespace luabz
  * called "insert" which accepts \n lua_State* and addional parameter which can
  * be anything. \pre Every specialization has to provice a static member
  * function called "get" accepting lua_State and stack_index and which convert
- * and returns the \n top element of the stack to the desired type. \note If one
+ * and returns the \n top element of the stack to the desired type. \n
+ * The optional static member function "is" accepting lua_State and stack_index
+ * checks whether the element can be converted, it's required by try_get and
+ * try_call. \n
+ * "get" can accept as third parameter the access policy, luabz::checked or
+ * luabz::unchecked, which is required by var_ref::get<T, Policy>. \note If one
  * of the required function is not provided you will not be the corresponding
  * functionality with the new type.
  */
@@ -20,9 +30,15 @@ template <>
 struct value<bool> {
     static void insert(lua_State* state, bool value) { interface::insert_bool(state, value); }
 
-    static bool get(lua_State* state, int stack_index)
+    static bool is(lua_State* state, int stack_index)
     {
-        return static_cast<bool>(interface::get_bool(state, stack_index));
+        return interface::is_bool(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static bool get(lua_State* state, int stack_index, Policy policy = Policy{})
+    {
+        return static_cast<bool>(interface::get_bool(state, stack_index, policy));
     }
 };
 
@@ -33,9 +49,15 @@ struct value<long long> {
         interface::insert_integer(state, value);
     }
 
-    static long long get(lua_State* state, int stack_index)
+    static bool is(lua_State* state, int stack_index)
+    {
+        return interface::is_number(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static long long get(lua_State* state, int stack_index, Policy policy = Policy{})
     {
-        return static_cast<long long>(interface::get_long(state, stack_index));
+        return static_cast<long long>(interface::get_long(state, stack_index, policy));
     }
 };
 
@@ -46,9 +68,15 @@ struct value<unsigned long long> {
         interface::insert_integer(state, value);
     }
 
-    static unsigned long long get(lua_State* state, int stack_index)
+    static bool is(lua_State* state, int stack_index)
     {
-        return static_cast<unsigned long long>(interface::get_long(state, stack_index));
+        return interface::is_number(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static unsigned long long get(lua_State* state, int stack_index, Policy policy = Policy{})
+    {
+        return static_cast<unsigned long long>(interface::get_long(state, stack_index, policy));
     }
 };
 
@@ -56,9 +84,15 @@ template <>
 struct value<long> {
     static void insert(lua_State* state, long value) { interface::insert_integer(state, value); }
 
-    static long get(lua_State* state, int stack_index)
+    static bool is(lua_State* state, int stack_index)
+    {
+        return interface::is_number(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static long get(lua_State* state, int stack_index, Policy policy = Policy{})
     {
-        return static_cast<long>(interface::get_long(state, stack_index));
+        return static_cast<long>(interface::get_long(state, stack_index, policy));
     }
 };
 
@@ -69,9 +103,15 @@ struct value<unsigned long> {
         interface::insert_integer(state, value);
     }
 
-    static unsigned long get(lua_State* state, int stack_index)
+    static bool is(lua_State* state, int stack_index)
+    {
+        return interface::is_number(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static unsigned long get(lua_State* state, int stack_index, Policy policy = Policy{})
     {
-        return static_cast<unsigned long>(interface::get_long(state, stack_index));
+        return static_cast<unsigned long>(interface::get_long(state, stack_index, policy));
     }
 };
 
@@ -79,9 +119,15 @@ template <>
 struct value<int> {
     static void insert(lua_State* state, int value) { interface::insert_integer(state, value); }
 
-    static int get(lua_State* state, int stack_index)
+    static bool is(lua_State* state, int stack_index)
     {
-        return static_cast<int>(interface::get_int(state, stack_index));
+        return interface::is_number(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static int get(lua_State* state, int stack_index, Policy policy = Policy{})
+    {
+        return static_cast<int>(interface::get_int(state, stack_index, policy));
     }
 };
 
@@ -92,9 +138,15 @@ struct value<unsigned int> {
         interface::insert_integer(state, value);
     }
 
-    static unsigned int get(lua_State* state, int stack_index)
+    static bool is(lua_State* state, int stack_index)
+    {
+        return interface::is_number(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static unsigned int get(lua_State* state, int stack_index, Policy policy = Policy{})
     {
-        return static_cast<unsigned int>(interface::get_int(state, stack_index));
+        return static_cast<unsigned int>(interface::get_int(state, stack_index, policy));
     }
 };
 
@@ -102,9 +154,15 @@ template <>
 struct value<float> {
     static void insert(lua_State* state, float value) { interface::insert_number(state, value); }
 
-    static float get(lua_State* state, int stack_index)
+    static bool is(lua_State* state, int stack_index)
     {
-        return static_cast<float>(interface::get_number(state, stack_index));
+        return interface::is_number(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static float get(lua_State* state, int stack_index, Policy policy = Policy{})
+    {
+        return static_cast<float>(interface::get_number(state, stack_index, policy));
     }
 };
 
@@ -112,9 +170,15 @@ template <>
 struct value<double> {
     static void insert(lua_State* state, double value) { interface::insert_number(state, value); }
 
-    static double get(lua_State* state, int stack_index)
+    static bool is(lua_State* state, int stack_index)
+    {
+        return interface::is_number(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static double get(lua_State* state, int stack_index, Policy policy = Policy{})
     {
-        return static_cast<double>(interface::get_number(state, stack_index));
+        return static_cast<double>(interface::get_number(state, stack_index, policy));
     }
 };
 
@@ -125,17 +189,82 @@ struct value<std::nullptr_t> {
 
 template <>
 struct value<std::string> {
-    static void insert(lua_State* state, std::string value)
+    static void insert(lua_State* state, const std::string& value)
     {
         lua_pushlstring(state, value.c_str(), value.size());
     }
 
-    static std::string get(lua_State* state, int stack_index)
+    static bool is(lua_State* state, int stack_index)
+    {
+        return interface::is_string(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static std::string get(lua_State* state, int stack_index, Policy policy = Policy{})
     {
-        return static_cast<std::string>(lua_tostring(state, stack_index));
+        std::size_t length = 0;
+        const char* text = interface::get_lstring(state, stack_index, length, policy);
+        return text != nullptr ? std::string(text, length) : std::string{};
     }
 };
 
+/**
+ * \brief Reads a lua string without copying it
+ * \note The pointer is valid only while the string stays on the stack, e.g. for
+ * the duration of a registered C++ function receiving it
+ */
+template <>
+struct value<const char*> {
+    static void insert(lua_State* state, const char* value)
+    {
+        if (value == nullptr) {
+            lua_pushnil(state);
+            return;
+        }
+        lua_pushstring(state, value);
+    }
+
+    static bool is(lua_State* state, int stack_index)
+    {
+        return interface::is_string(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static const char* get(lua_State* state, int stack_index, Policy policy = Policy{})
+    {
+        std::size_t length = 0;
+        return interface::get_lstring(state, stack_index, length, policy);
+    }
+};
+
+#ifdef LUABZ_HAS_STRING_VIEW
+/**
+ * \brief Reads a lua string without copying it, embedded zeros included
+ * \note The view is valid only while the string stays on the stack, e.g. for
+ * the duration of a registered C++ function receiving it
+ */
+template <>
+struct value<std::string_view> {
+    static void insert(lua_State* state, std::string_view value)
+    {
+        lua_pushlstring(state, value.data(), value.size());
+    }
+
+    static bool is(lua_State* state, int stack_index)
+    {
+        return interface::is_string(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static std::string_view get(lua_State* state, int stack_index, Policy policy = Policy{})
+    {
+        std::size_t length = 0;
+        const char* text = interface::get_lstring(state, stack_index, length, policy);
+        return text != nullptr ? std::string_view(text, length) : std::string_view{};
+    }
+};
+#endif
+
 template <>
 struct value<char> {
     static void insert(lua_State* state, char value)
@@ -143,9 +272,15 @@ struct value<char> {
         luabz::value<std::string>::insert(state, std::string{value});
     }
 
-    static char get(lua_State* state, int stack_index)
+    static bool is(lua_State* state, int stack_index)
+    {
+        return interface::is_string(state, stack_index);
+    }
+
+    template <typename Policy = checked>
+    static char get(lua_State* state, int stack_index, Policy policy = Policy{})
     {
-        return luabz::value<std::string>::get(state, stack_index)[0];
+        return luabz::value<std::string>::get(state, stack_index, policy)[0];
     }
 };
 
@@ -1,5 +1,6 @@
 #pragma once
 #include "error.hpp"
+#include "interface.hpp"
 #include <lua.hpp>
 #include <string>
 namespace luabz
@@ -7,6 +8,11 @@ namespace luabz
 /**
  * \brief RAII helper used to push to the top of the stack a specific
  * lua_variable
+ * \note The destructor restores the stack top observed by the constructor,
+ * so the stack is balanced whatever happened in between, e.g. a failed call
+ * leaving its error message on the stack. \n
+ * When a parent is not a table a nil is left in place of the variable, the
+ * callers which write the variable must check is_valid first.
  */
 class var_loader
 {
@@ -15,52 +21,61 @@ class var_loader
      * Pushes to the top of the stack a specific lua variable
      * \param st The state in which the variable is present
      * \param variable_name The name of the lua variable
-     * \param us Starting used stack space
+     * \param report_errors When false a parent which is not a table is only
+     * signaled through is_valid(), instead of being reported through
+     * luabz::error
      */
-    var_loader(lua_State* st, const std::string& variable_name) : state{st}, used_space{0}
+    var_loader(lua_State* st, const std::string& variable_name, bool report_errors = true)
+      : m_state{st}, m_initialTop{lua_gettop(st)}
     {
-        if (variable_name.find('.') != std::string::npos) {
-            auto delimeter_position = variable_name.find_first_of('.');
-            std::string table_name = variable_name.substr(0, delimeter_position);
-            std::string field_name = variable_name.substr(delimeter_position + 1);
-            lua_getglobal(state, table_name.c_str());
-            ++used_space;
-            while (true) {
-                delimeter_position = field_name.find_first_of('.');
-                bool field_reached = (delimeter_position == std::string::npos);
-                if (field_reached) {
-                    lua_getfield(state, -1, field_name.c_str());
-                    ++used_space;
-                    return;
-                }
-                std::string parent_field_name = field_name.substr(0, delimeter_position);
-                field_name = field_name.substr(delimeter_position + 1);
-                lua_getfield(state, -1, parent_field_name.c_str());
-                ++used_space;
-                if (!lua_istable(state, -1)) {
-                    std::string error_message = parent_field_name;
-                    error_message += " is not a table, and cannot contain the "
-                                     "following  fields ";
-                    error_message += field_name;
-                    error_message += std::to_string(used_space);
+        auto delimeter_position = variable_name.find('.');
+        if (delimeter_position == std::string::npos) {
+            interface::get_global(m_state, variable_name.c_str());
+            return;
+        }
+        std::string field_name = variable_name.substr(0, delimeter_position);
+        interface::get_global(m_state, field_name.c_str());
+        while (delimeter_position != std::string::npos) {
+            if (!lua_istable(m_state, -1)) {
+                m_valid = false;
+                // The placeholder keeps the variable at the expected depth
+                lua_settop(m_state, m_initialTop);
+                lua_pushnil(m_state);
+                if (report_errors) {
+                    std::string error_message = field_name;
+                    error_message += " is not a table, and cannot contain the following fields ";
+                    error_message += variable_name.substr(delimeter_position + 1);
                     error_message += "\nOriginal string: ";
                     error_message += variable_name;
                     error_message += "\n";
-                    error(error_message);
+                    // The destructor doesn't run when error throws
+                    lua_settop(m_state, m_initialTop);
+                    error(error_message, error_kind::not_a_table);
+                    lua_pushnil(m_state);
                 }
+                return;
             }
+            auto field_begin = delimeter_position + 1;
+            delimeter_position = variable_name.find('.', field_begin);
+            field_name = variable_name.substr(field_begin, delimeter_position - field_begin);
+            lua_getfield(m_state, -1, field_name.c_str());
         }
-        lua_getfield(state, LUA_GLOBALSINDEX, variable_name.c_str());
-        ++used_space;
     }
 
-    ~var_loader() { lua_pop(state, (used_space)); }
-    // TODO:Find better way of doing this
-    void increment_used_space() { ++used_space; }
+    var_loader(const var_loader&) = delete;
+
+    var_loader& operator=(const var_loader&) = delete;
+
+    ~var_loader() { lua_settop(m_state, m_initialTop); }
+
+    /// False when one of the parents of the variable is not a table
+    bool is_valid() const { return m_valid; }
 
   private:
-    lua_State* state;
+    lua_State* m_state;
+
+    int m_initialTop;
 
-    int used_space;
+    bool m_valid = true;
 };
-}  // namespace luabz
\ No newline at end of file
+}  // namespace luabz
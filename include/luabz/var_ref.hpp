@@ -1,11 +1,22 @@
 #pragma once
+#include "budget.hpp"
+#include "environment.hpp"
 #include "error.hpp"
+#include "expected.hpp"
+#include "marshal.hpp"
+#include "metrics.hpp"
+#include "overloads.hpp"
+#include "serializer.hpp"
+#include "snapshot.hpp"
+#include "table_range.hpp"
+#include "table_visitor.hpp"
 #include "traits/callable_traits.hpp"
 #include "value.hpp"
 #include "var_loader.hpp"
 #include <chrono>
 #include <cstddef>
 #include <functional>
+#include <memory>
 #include <random>
 #include <string>
 #include <tuple>
@@ -33,6 +44,9 @@ class var_ref
     bool is_nil() const
     {
         var_loader loader(m_state, m_name);
+        if (!loader.is_valid()) {
+            return true;
+        }
         auto result = static_cast<bool>(lua_isnil(m_state, -1));
         return result;
     }
@@ -60,12 +74,78 @@ class var_ref
     template <typename ReturnType, typename... Args>
     void assign(ReturnType (*user_f)(Args...));
 
+    /**
+     * \brief Registers the overloads as a single lua function, which
+     * dispatches on the number and the lua types of its arguments
+     * \sa overload_set
+     */
+    template <typename... Fs>
+    void assign(overload_set<Fs...> user_overloads);
+
+    /**
+     * \brief Registers several callables as a single lua function
+     * \sa assign(overload_set<Fs...>)
+     */
+    template <typename F1, typename F2, typename... Fs>
+    void assign(F1 first, F2 second, Fs... others);
+
     template <typename... Args>
     var_ref operator()(Args&&... args);
 
     template <typename... Results, typename... Args>
     std::tuple<Results...> call(Args&&.../*unused*/);
 
+    /**
+     * \brief Calls the lua function enforcing an instruction budget and/or a
+     * deadline
+     * \note When the budget is exceeded the call is interrupted and the error is
+     * reported with error_kind::budget_exceeded
+     */
+    template <typename... Args>
+    var_ref operator()(budget limit, Args&&... args);
+
+    /**
+     * \sa operator()(budget, Args&&...)
+     */
+    template <typename... Results, typename... Args>
+    std::tuple<Results...> call(budget limit, Args&&... args);
+
+    /**
+     * \brief Calls the lua function with env as its environment, the globals
+     * it reads fall back to the globals of the state and the ones it assigns
+     * are stored in env
+     * \note The previous environment of the function is restored after the
+     * call. Since 5.2 the environment is shared by the functions defined in
+     * the same chunk, they see env as well while the call is running.
+     */
+    template <typename... Results, typename... Args>
+    std::tuple<Results...> call(environment& env, Args&&... args);
+
+    /**
+     * \brief Calls the lua function without reporting errors through
+     * luabz::error
+     * \note The failure is returned as error_info, either not_a_table,
+     * not_a_function, runtime, budget_exceeded or type_mismatch when a result
+     * cannot be converted. The stack is balanced on every path.
+     */
+    template <typename... Results, typename... Args>
+    expected<std::tuple<Results...>, error_info> try_call(Args&&... args);
+
+    /**
+     * \sa try_call(Args&&...)
+     * \sa operator()(budget, Args&&...)
+     */
+    template <typename... Results, typename... Args>
+    expected<std::tuple<Results...>, error_info> try_call(budget limit, Args&&... args);
+
+    /**
+     * \brief Conversion from var_ref to T without reporting errors through
+     * luabz::error
+     * \pre The specialization of luabz::value with type T must provide "is"
+     */
+    template <typename T>
+    expected<typename std::decay<T>::type, error_info> try_get() const;
+
     /**
      * \brief Conversion from var_ref to any type T
      * \pre There must be a specialization of luabz::value with type
@@ -74,6 +154,14 @@ class var_ref
     template <typename T>
     operator T() const;
 
+    /**
+     * \brief Explicit conversion from var_ref to T with the requested access
+     * policy
+     * \note luabz::unchecked skips the type checks, see luabz::unchecked
+     */
+    template <typename T, typename Policy = checked>
+    T get() const;
+
     /**
      * \brief Operator for setting the value of the lua variable
      * \note In order to handle global variables and table fields with the same
@@ -87,6 +175,65 @@ class var_ref
     template <typename T>
     var_ref& operator=(T new_value);
 
+    /**
+     * \brief Assigns the lua value of rhs to this variable, rhs can belong to
+     * another lua state
+     * \note Values are copied between different states through serializer,
+     * functions and userdata cannot be copied and become nil
+     */
+    var_ref& operator=(const var_ref& rhs)
+    {
+        if (this == &rhs) {
+            return *this;
+        }
+        var_loader loader(m_state, m_name);
+        if (!loader.is_valid()) {
+            return *this;
+        }
+        push_value_of(rhs);
+        set_lua_var();
+        return *this;
+    }
+
+    /**
+     * \brief Encodes the lua value into output, e.g. to copy it into several
+     * states through decode
+     */
+    void encode(serializer& output) const
+    {
+        var_loader loader(m_state, m_name);
+        if (!loader.is_valid()) {
+            return;
+        }
+        output.encode(m_state, -1);
+    }
+
+    /**
+     * \brief Assigns to this variable the value held by input
+     */
+    var_ref& decode(const serializer& input)
+    {
+        var_loader loader(m_state, m_name);
+        if (!loader.is_valid()) {
+            return *this;
+        }
+        if (!input.decode(m_state)) {
+            luabz::error("The serialized value is malformed and cannot be decoded");
+            return *this;
+        }
+        set_lua_var();
+        return *this;
+    }
+
+    /**
+     * \brief Read-modify-write of the lua variable
+     * \note The variable is loaded once, fn receives its current value converted
+     * to T and the result of fn is stored through the same parent table, so
+     * nested table fields are walked only once.
+     */
+    template <typename T, typename F>
+    var_ref& update(F fn);
+
     /**
      * \brief Operator= between var_ref and any type T
      * \note Temporary variable of type T is created, this temporal represents
@@ -136,9 +283,72 @@ class var_ref
     template <typename T>
     var_ref& operator*=(const T& rhs);
 
-    bool operator<(const var_ref& rhs) const { return call_lua_operator(rhs, lua_lessthan); }
+    bool operator<(const var_ref& rhs) const
+    {
+        return call_lua_operator(rhs, interface::less_than);
+    }
+
+    bool operator==(const var_ref& rhs) const { return call_lua_operator(rhs, interface::equal); }
+
+    /**
+     * \brief Traverses the table with lua_next, yielding the key and the value
+     * of every pair as proxies reading straight from the stack
+     * \code
+     * for (auto entry : script["table"].pairs()) {
+     *     auto key = entry.key.get<std::string>();
+     *     auto value = entry.value.get<int>();
+     * }
+     * \endcode
+     * \sa table_range
+     */
+    table_range pairs() const { return table_range{m_state, m_name}; }
+
+    /**
+     * \brief Calls f with the key and the value, as stack_value, of every pair
+     * of the table
+     */
+    template <typename F>
+    void for_each(F&& f) const
+    {
+        for (auto entry : pairs()) {
+            f(entry.key, entry.value);
+        }
+    }
+
+    /**
+     * \brief Streams the table, nested tables included, to visitor as
+     * begin_table/key/scalar/end_table events, without materializing it
+     * \sa table_visitor
+     * \sa table_walker
+     */
+    template <typename Visitor>
+    void visit(Visitor&& visitor, std::size_t max_depth = 64) const
+    {
+        var_loader loader(m_state, m_name, false);
+        if (!lua_istable(m_state, -1)) {
+            error(m_name + " is not a table, and cannot be visited", error_kind::not_a_table);
+            return;
+        }
+        table_walker<typename std::remove_reference<Visitor>::type> walker{m_state, visitor,
+                                                                           max_depth};
+        walker.walk(-1);
+    }
 
-    bool operator==(const var_ref& rhs) const { return call_lua_operator(rhs, lua_equal); }
+    /**
+     * \brief Copies the table into an immutable snapshot, which can be read
+     * from any thread, paths are relative to this table
+     * \sa snapshot_publisher
+     */
+    std::shared_ptr<const snapshot> take_snapshot(std::size_t max_depth = 16) const
+    {
+        var_loader loader(m_state, m_name);
+        if (!lua_istable(m_state, -1)) {
+            luabz::error("What you are trying to snapshot is not a lua table",
+                         error_kind::not_a_table);
+            return std::make_shared<const snapshot>();
+        }
+        return snapshot::from_table(m_state, -1, max_depth);
+    }
 
     /**
      * \brief Access a field of the current var_ref
@@ -165,22 +375,32 @@ class var_ref
     void set_lua_var()
     {
         static const int object_table_index = -3;
-        int lua_table_index = (is_table_field()) ? object_table_index : LUA_GLOBALSINDEX;
-        std::string lua_variable_name = (is_table_field()) ? get_field_name() : m_name;
-        lua_setfield(m_state, lua_table_index, lua_variable_name.c_str());
+        if (is_table_field()) {
+            lua_setfield(m_state, object_table_index, get_field_name().c_str());
+        } else {
+            interface::set_global(m_state, m_name.c_str());
+        }
     }
 
     void insert_CFunction(std::function<int(lua_State*)>&& user_function)
     {
-        std::size_t user_function_index =
-            state::register_cpp_function(m_state, std::move(user_function));
         var_loader loader(m_state, m_name);
-        value<decltype(user_function_index)>::insert(m_state, user_function_index);
+        if (!loader.is_valid()) {
+            return;
+        }
+        const auto* registered_function =
+            state::register_cpp_function(m_state, std::move(user_function));
+        lua_pushlightuserdata(
+            m_state, const_cast<void*>(static_cast<const void*>(registered_function)));
         lua_CFunction new_value = [](lua_State* functionState) -> int {
-            int functionIndex =
-                lua_tointeger(functionState, lua_upvalueindex(1));  // retrieve  upvalue
-            auto function = state::get_cpp_registered_function(functionIndex);
-            return function(functionState);
+            const auto* function = static_cast<const std::function<int(lua_State*)>*>(
+                lua_touserdata(functionState, lua_upvalueindex(1)));  // retrieve  upvalue
+            int results_count = (*function)(functionState);
+            if (results_count < 0) {
+                // Raised here, once the C++ frames of the function are gone
+                return lua_error(functionState);
+            }
+            return results_count;
         };
         value<lua_CFunction>::insert(m_state, new_value, 1);
         set_lua_var();
@@ -191,16 +411,34 @@ class var_ref
     {
         int lhs_index = -2, rhs_index = -1;
         var_loader lhs_loader(m_state, m_name);
-        var_loader rhs_loader(rhs.m_state, rhs.m_name);
-        if (m_state != rhs.m_state) {
-            lua_xmove(rhs.m_state, m_state, 1);
-            // TODO:Find better way of doing this
-            lhs_loader.increment_used_space();
+        if (!lhs_loader.is_valid()) {
+            return false;
         }
+        push_value_of(rhs);
         auto result = static_cast<bool>(lua_operator(m_state, lhs_index, rhs_index));
         return result;
     }
 
+    /**
+     * \brief Pushes onto the top of the stack the value of rhs, copying it
+     * through serializer when rhs belongs to another lua state
+     */
+    void push_value_of(const var_ref& rhs) const
+    {
+        if (rhs.m_state != m_state) {
+            // The states are unrelated, lua_xmove would be undefined
+            static thread_local serializer transfer_serializer;
+            var_loader rhs_loader(rhs.m_state, rhs.m_name);
+            transfer_serializer.transfer(rhs.m_state, -1, m_state);
+            return;
+        }
+        int value_index = lua_gettop(m_state) + 1;
+        lua_pushnil(m_state);
+        var_loader rhs_loader(m_state, rhs.m_name);
+        // rhs_loader restores the top to value_index, which now holds the value
+        lua_replace(m_state, value_index);
+    }
+
     std::string generate_return_value_name() const
     {
         std::uniform_int_distribution<int> distribution;
@@ -213,27 +451,64 @@ class var_ref
 
     /**
      * \brief assign a registered function, it also extracts function's
-     * parameters from the lua stack and insert the return value of the
+     * parameters from the lua stack and insert the return values of the
      * function into the stack
+     * \sa argument, results
      */
     template <typename T, typename ReturnType, typename... Args, std::size_t... I>
-    int call_registered_function(T& user_f,
-                                 std::pair<ReturnType, std::tuple<Args...>>&/*unused*/,
-                                 std::index_sequence<I...>&&/*unused*/);
+    static int call_registered_function(lua_State* state,
+                                        call_timer& timer,
+                                        T& user_f,
+                                        signature<ReturnType, Args...> /*unused*/,
+                                        std::index_sequence<I...>&&/*unused*/);
 
     /**
      * \brief assign a registered function, it also extracts function's
-     * parameters from the lua stack and insert the return value of the
+     * parameters from the lua stack and insert the return values of the
      * function into the stack
+     * \sa argument, results
      */
     template <typename C, typename F, typename ReturnType, typename... Args, std::size_t... I>
-    int call_registered_function(C obj,
-                                 F user_f,
-                                 std::pair<ReturnType, std::tuple<Args...>>&/*unused*/,
-                                 std::index_sequence<I...>&&/*unused*/);
+    static int call_registered_function(lua_State* state,
+                                        call_timer& timer,
+                                        C obj,
+                                        F user_f,
+                                        signature<ReturnType, Args...> /*unused*/,
+                                        std::index_sequence<I...>&&/*unused*/);
+
+    /// \sa call_registered_function(lua_State*, call_timer&, T&, signature, index_sequence)
+    template <typename T, typename ReturnType, typename... Args>
+    static int call_registered_function(lua_State* state,
+                                        call_timer& timer,
+                                        T& user_f,
+                                        signature<ReturnType, Args...> user_signature)
+    {
+        return call_registered_function(state, timer, user_f, user_signature,
+                                        std::index_sequence_for<Args...>());
+    }
+
+    /**
+     * \brief Calls the lua function on top of the stack, reporting errors
+     * through luabz::error
+     * \return false when the call failed
+     */
+    template <typename... Args>
+    bool call_lua_function(call_timer& timer, size_t output_count, Args&&... args);
 
+    /**
+     * \brief Calls the lua function on top of the stack without reporting
+     * errors, on failure kind is set and, unless the variable is not a
+     * function, the lua error message is left on top of the stack
+     */
     template <typename... Args>
-    void call_lua_function(size_t output_count, Args&&... args);
+    bool protected_call(call_timer& timer, size_t output_count, error_kind& kind, Args&&... args);
+
+    /// Returns the lua error message on top of the stack, empty if it's not a string
+    std::string top_error_message() const
+    {
+        const char* message = lua_tostring(m_state, -1);
+        return message != nullptr ? message : "";
+    }
 
     // TODO:Find better way of doing this
     template <typename T, typename... Args>
@@ -246,19 +521,24 @@ class var_ref
 
     template <typename... Results, std::size_t... I>
     std::tuple<Results...> get_fn_result(std::index_sequence<I...>&&/*unused*/);
+
+    template <typename... Results, std::size_t... I>
+    bool fn_result_is(std::index_sequence<I...>&&/*unused*/) const;
 };
 
 template <typename T>
 void var_ref::assign(T user_f)
 {
     using namespace utilitybz;
-    std::function<int(lua_State*)> f = [this, user_function = std::move(user_f)](lua_State*) {
+    std::function<int(lua_State*)> f = [name = m_name,
+                                        user_function = std::move(user_f)](lua_State* state) {
+        call_timer timer(state, call_kind::cpp_function, name);
         constexpr std::size_t args_count = callable_traits<T>::args_count;
-        bool correct_number_of_arguments = (lua_gettop(m_state) == args_count);
+        using signature_type =
+            typename make_signature<callable_return_type_t<T>, callable_args_types_t<T>>::type;
 
-        if (correct_number_of_arguments) {
-            std::pair<callable_return_type_t<T>, callable_args_types_t<T>> t{};
-            return call_registered_function(user_function, t,
+        if (accepts_arguments(state, signature_type{})) {
+            return call_registered_function(state, timer, user_function, signature_type{},
                                             std::make_index_sequence<args_count>());
         }
         return 0;  // Return values count
@@ -269,14 +549,14 @@ void var_ref::assign(T user_f)
 template <typename Class, typename ReturnType, typename... Args>
 void var_ref::assign(Class* obj, ReturnType (Class::*member)(Args...))
 {
-    std::function<int(lua_State*)> f = [this, object = obj,
-                                        member_function = std::move(member)](lua_State*) {
+    std::function<int(lua_State*)> f = [name = m_name, object = obj,
+                                        member_function = std::move(member)](lua_State* state) {
+        call_timer timer(state, call_kind::cpp_function, name);
         constexpr std::size_t args_count = sizeof...(Args);
-        bool correct_number_of_arguments = (lua_gettop(m_state) == args_count);
 
-        if (correct_number_of_arguments) {
-            std::pair<ReturnType, std::tuple<Args...>> t{};
-            return call_registered_function(object, member_function, t,
+        if (accepts_arguments(state, signature<ReturnType, Args...>{})) {
+            return call_registered_function(state, timer, object, member_function,
+                                            signature<ReturnType, Args...>{},
                                             std::make_index_sequence<args_count>());
         }
         return 0;  // Return values count
@@ -287,13 +567,13 @@ void var_ref::assign(Class* obj, ReturnType (Class::*member)(Args...))
 template <typename ReturnType, typename... Args>
 void var_ref::assign(std::function<ReturnType(Args...)> user_f)
 {
-    std::function<int(lua_State*)> f = [this,
-                                        user_function = std::move(user_f)](lua_State*) -> int {
+    std::function<int(lua_State*)> f = [name = m_name, user_function = std::move(user_f)](
+                                           lua_State* state) -> int {
+        call_timer timer(state, call_kind::cpp_function, name);
         constexpr std::size_t args_count = sizeof...(Args);
-        bool correct_number_of_arguments = (lua_gettop(m_state) == args_count);
-        if (correct_number_of_arguments) {
-            std::pair<ReturnType, std::tuple<Args...>> t{};
-            return call_registered_function(user_function, t,
+        if (accepts_arguments(state, signature<ReturnType, Args...>{})) {
+            return call_registered_function(state, timer, user_function,
+                                            signature<ReturnType, Args...>{},
                                             std::make_index_sequence<args_count>());
         }
         return 0;  // Return values count
@@ -307,27 +587,71 @@ void var_ref::assign(ReturnType (*user_f)(Args...))
     assign(std::function<ReturnType(Args...)>(user_f));
 }
 
+template <typename... Fs>
+void var_ref::assign(overload_set<Fs...> user_overloads)
+{
+    std::function<int(lua_State*)> f = [name = m_name, set = std::move(user_overloads)](
+                                           lua_State* state) -> int {
+        call_timer timer(state, call_kind::cpp_function, name);
+        int results_count =
+            set.dispatch(state, [state, &timer](auto& user_function, auto user_signature) {
+                return call_registered_function(state, timer, user_function, user_signature);
+            });
+        if (results_count < 0) {
+            push_no_overload_error(state, name.c_str());
+        }
+        return results_count;
+    };
+    insert_CFunction(std::move(f));
+}
+
+template <typename F1, typename F2, typename... Fs>
+void var_ref::assign(F1 first, F2 second, Fs... others)
+{
+    assign(overloads(std::move(first), std::move(second), std::move(others)...));
+}
+
 // Operators
 
 template <typename T>
 var_ref::operator T() const
 {
     var_loader loader(m_state, m_name);
+    if (!loader.is_valid()) {
+        return T{};
+    }
     T result = value<typename std::decay<T>::type>::get(m_state, -1);
     return result;
 }
 
+template <typename T, typename Policy>
+T var_ref::get() const
+{
+    var_loader loader(m_state, m_name);
+    if (!loader.is_valid()) {
+        return T{};
+    }
+    return value<typename std::decay<T>::type>::get(m_state, -1, Policy{});
+}
+
 template <typename... Args>
 var_ref var_ref::operator()(Args&&... args)
 {
     constexpr size_t output_count = 1;
+    call_timer timer(m_state, call_kind::lua_function, m_name);
     var_loader loader(m_state, m_name);
-
-    call_lua_function(output_count, std::forward<Args>(args)...);
     // TODO:Do i need to generate name here ?
     auto return_value_name = generate_return_value_name();
+    if (!loader.is_valid()) {
+        return var_ref(m_state, return_value_name);
+    }
+
+    bool success = call_lua_function(timer, output_count, std::forward<Args>(args)...);
 
-    lua_setfield(m_state, LUA_GLOBALSINDEX, return_value_name.c_str());
+    // When the call failed the returned variable is left nil
+    if (success) {
+        interface::set_global(m_state, return_value_name.c_str());
+    }
     return var_ref(m_state, return_value_name);
 }
 
@@ -335,21 +659,118 @@ template <typename... Results, typename... Args>
 std::tuple<Results...> var_ref::call(Args&&... args)
 {
     constexpr size_t output_count = sizeof...(Results);
+    call_timer timer(m_state, call_kind::lua_function, m_name);
     var_loader loader(m_state, m_name);
 
-    call_lua_function(output_count, std::forward<Args>(args)...);
+    if (!loader.is_valid() ||
+        !call_lua_function(timer, output_count, std::forward<Args>(args)...)) {
+        return std::tuple<Results...>{};
+    }
+    return get_fn_result<Results...>(std::make_index_sequence<output_count>());
+}
+
+template <typename... Args>
+var_ref var_ref::operator()(budget limit, Args&&... args)
+{
+    budget_guard guard(m_state, limit);
+    return operator()(std::forward<Args>(args)...);
+}
+
+template <typename... Results, typename... Args>
+std::tuple<Results...> var_ref::call(budget limit, Args&&... args)
+{
+    budget_guard guard(m_state, limit);
+    return call<Results...>(std::forward<Args>(args)...);
+}
+
+template <typename... Results, typename... Args>
+std::tuple<Results...> var_ref::call(environment& env, Args&&... args)
+{
+    if (!env.belongs_to(m_state)) {
+        error(error_info{error_kind::invalid_environment, m_name}.message(),
+              error_kind::invalid_environment);
+        return std::tuple<Results...>{};
+    }
+    // The errors are reported by the call itself
+    var_loader loader(m_state, m_name, false);
+    if (!loader.is_valid()) {
+        error(m_name + " cannot be called, one of its parents is not a table",
+              error_kind::not_a_table);
+        return std::tuple<Results...>{};
+    }
+    environment_scope scope(m_state, -1, env);
+    return call<Results...>(std::forward<Args>(args)...);
+}
+
+template <typename... Results, typename... Args>
+expected<std::tuple<Results...>, error_info> var_ref::try_call(Args&&... args)
+{
+    constexpr size_t output_count = sizeof...(Results);
+    call_timer timer(m_state, call_kind::lua_function, m_name);
+    var_loader loader(m_state, m_name, false);
+    if (!loader.is_valid()) {
+        return make_unexpected(error_info{error_kind::not_a_table, m_name});
+    }
+    error_kind kind = error_kind::runtime;
+    if (!protected_call(timer, output_count, kind, std::forward<Args>(args)...)) {
+        if (kind == error_kind::not_a_function) {
+            return make_unexpected(error_info{kind, m_name});
+        }
+        return make_unexpected(error_info{kind, m_name, top_error_message()});
+    }
+    if (!fn_result_is<Results...>(std::make_index_sequence<output_count>())) {
+        return make_unexpected(error_info{error_kind::type_mismatch, m_name});
+    }
     return get_fn_result<Results...>(std::make_index_sequence<output_count>());
 }
 
+template <typename... Results, typename... Args>
+expected<std::tuple<Results...>, error_info> var_ref::try_call(budget limit, Args&&... args)
+{
+    budget_guard guard(m_state, limit);
+    return try_call<Results...>(std::forward<Args>(args)...);
+}
+
+template <typename T>
+expected<typename std::decay<T>::type, error_info> var_ref::try_get() const
+{
+    using value_type = typename std::decay<T>::type;
+    var_loader loader(m_state, m_name, false);
+    if (!loader.is_valid()) {
+        return make_unexpected(error_info{error_kind::not_a_table, m_name});
+    }
+    if (!value<value_type>::is(m_state, -1)) {
+        return make_unexpected(error_info{error_kind::type_mismatch, m_name});
+    }
+    return value<value_type>::get(m_state, -1);
+}
+
 template <typename T>
 var_ref& var_ref::operator=(T new_value)
 {
     var_loader loader(m_state, m_name);
+    if (!loader.is_valid()) {
+        return *this;
+    }
     value<T>::insert(m_state, new_value);
     set_lua_var();
     return *this;
 }
 
+template <typename T, typename F>
+var_ref& var_ref::update(F fn)
+{
+    using value_type = typename std::decay<T>::type;
+    var_loader loader(m_state, m_name);
+    if (!loader.is_valid()) {
+        return *this;
+    }
+    value_type current = value<value_type>::get(m_state, -1);
+    value<value_type>::insert(m_state, static_cast<value_type>(fn(current)));
+    set_lua_var();
+    return *this;
+}
+
 template <typename T>
 bool var_ref::operator==(const T& rhs) const
 {
@@ -399,10 +820,7 @@ T var_ref::operator+(const T& rhs) const
 template <typename T>
 var_ref& var_ref::operator+=(const T& rhs)
 {
-    // TODO:Temporary generated here
-    // This should implement the logic and operator+ should call this one
-    this->operator=(static_cast<T>(this->operator+(rhs)));
-    return *this;
+    return update<T>([&rhs](const T& lhs) { return lhs + rhs; });
 }
 
 template <typename T>
@@ -415,8 +833,7 @@ T var_ref::operator-(const T& rhs) const
 template <typename T>
 var_ref& var_ref::operator-=(const T& rhs)
 {
-    this->operator=(static_cast<T>(this->operator-(rhs)));
-    return *this;
+    return update<T>([&rhs](const T& lhs) { return lhs - rhs; });
 }
 
 template <typename T>
@@ -429,8 +846,7 @@ T var_ref::operator/(const T& rhs) const
 template <typename T>
 var_ref& var_ref::operator/=(const T& rhs)
 {
-    this->operator=(static_cast<T>(this->operator/(rhs)));
-    return *this;
+    return update<T>([&rhs](const T& lhs) { return lhs / rhs; });
 }
 
 template <typename T>
@@ -443,33 +859,40 @@ T var_ref::operator*(const T& rhs) const
 template <typename T>
 var_ref& var_ref::operator*=(const T& rhs)
 {
-    this->operator=(static_cast<T>(this->operator*(rhs)));
-    return *this;
+    return update<T>([&rhs](const T& lhs) { return lhs * rhs; });
 }
 
 // Helpers
 template <typename T, typename ReturnType, typename... Args, std::size_t... I>
-int var_ref::call_registered_function(T& user_f,
-                                      std::pair<ReturnType, std::tuple<Args...>>&/*unused*/,
+int var_ref::call_registered_function(lua_State* state,
+                                      call_timer& timer,
+                                      T& user_f,
+                                      signature<ReturnType, Args...> /*unused*/,
                                       std::index_sequence<I...>&&/*unused*/)
 {
-    std::negate<> negate;
-    auto result = user_f(value<typename std::decay<Args>::type>::get(
-        m_state, negate((sizeof...(Args) - static_cast<int>(I))))...);
-    value<decltype(result)>::insert(m_state, result);
-    return 1;
+    // The arguments sit at the bottom of the stack of the call, from index 1
+    return results<typename std::decay<ReturnType>::type>::invoke(state, [&]() -> decltype(auto) {
+        return invoke_timed(timer, user_f,
+                            argument<typename std::decay<Args>::type>::get(
+                                state, static_cast<int>(I) + 1)...);
+    });
 }
 template <typename C, typename F, typename ReturnType, typename... Args, std::size_t... I>
-int var_ref::call_registered_function(C obj,
+int var_ref::call_registered_function(lua_State* state,
+                                      call_timer& timer,
+                                      C obj,
                                       F user_f,
-                                      std::pair<ReturnType, std::tuple<Args...>>&/*unused*/,
+                                      signature<ReturnType, Args...> /*unused*/,
                                       std::index_sequence<I...>&&/*unused*/)
 {
-    std::negate<> negate;
-    auto result = (obj->*user_f)(value<typename std::decay<Args>::type>::get(
-        m_state, negate((sizeof...(Args) - static_cast<int>(I))))...);
-    value<decltype(result)>::insert(m_state, result);
-    return 1;
+    auto member_call = [obj, user_f](auto&&... member_args) -> decltype(auto) {
+        return (obj->*user_f)(std::forward<decltype(member_args)>(member_args)...);
+    };
+    return results<typename std::decay<ReturnType>::type>::invoke(state, [&]() -> decltype(auto) {
+        return invoke_timed(timer, member_call,
+                            argument<typename std::decay<Args>::type>::get(
+                                state, static_cast<int>(I) + 1)...);
+    });
 }
 
 template <typename... Results, std::size_t... I>
@@ -480,20 +903,57 @@ std::tuple<Results...> var_ref::get_fn_result(std::index_sequence<I...>&& /*unus
         m_state, negate((sizeof...(Results) - static_cast<int>(I))))...);
 }
 
+template <typename... Results, std::size_t... I>
+bool var_ref::fn_result_is(std::index_sequence<I...>&& /*unused*/) const
+{
+    bool result = true;
+    using expander = int[];
+    (void)expander{0, (result = result && value<typename std::decay<Results>::type>::is(
+                                             m_state, -static_cast<int>(sizeof...(Results) - I)),
+                       0)...};
+    return result;
+}
+
 template <typename... Args>
-void var_ref::call_lua_function(size_t output_count, Args&&... args)
+bool var_ref::call_lua_function(call_timer& timer, size_t output_count, Args&&... args)
 {
-    if (!lua_isfunction(m_state, -1)) {
+    error_kind kind = error_kind::runtime;
+    if (protected_call(timer, output_count, kind, std::forward<Args>(args)...)) {
+        return true;
+    }
+    if (kind == error_kind::not_a_function) {
         error("You are trying to call something that is not "
-              "neither Lua function nor C/C++ function");
+              "neither Lua function nor C/C++ function",
+              kind);
+    } else {
+        error(top_error_message(), kind);
+    }
+    return false;
+}
+
+template <typename... Args>
+bool var_ref::protected_call(call_timer& timer,
+                             size_t output_count,
+                             error_kind& kind,
+                             Args&&... args)
+{
+    if (!lua_isfunction(m_state, -1)) {
+        kind = error_kind::not_a_function;
+        return false;
     }
     constexpr int input_count = sizeof...(Args);
     push_fn_param(std::forward<Args>(args)...);
-    // Note: There is no need to increment used_stack_spaces for
-    // the arguments because lua_pcall automatically pops them
-    if (lua_pcall(m_state, input_count, output_count, 0) != 0) {
-        error(lua_tostring(m_state, -1));
+    // Note: The results and the error message are popped by var_loader,
+    // which restores the stack top
+    timer.begin_inner();
+    int call_status = lua_pcall(m_state, input_count, output_count, 0);
+    timer.end_inner();
+    if (call_status != 0) {
+        kind = budget_guard::is_exceeded(m_state) ? error_kind::budget_exceeded
+                                                  : error_kind::runtime;
+        return false;
     }
+    return true;
 }
 
 template <typename T, typename... Args>
@@ -1,7 +1,230 @@
 #include "luabz.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
-//INFO:This file is used only to run clang-tidy on the headers
-int main(int /*argc*/,char** /*argv*/){
+// Load generator driving a lua script from several threads, each one owning its own lua state.
+// The same executable is also used to run clang-tidy on the headers.
+namespace
+{
+using clock_type = std::chrono::steady_clock;
 
+enum operation : std::size_t { read, write, lua_call, cpp_callback, operation_count };
+
+const std::array<const char*, operation_count> operation_names{
+    {"read", "write", "lua_call", "cpp_callback"}};
+
+struct options {
+    std::string script_path = std::string{LUABZ_PROJECT_FOLDER_PATH} + "/src/scripts/loadgen.lua";
+    std::size_t threads = 4;
+    double duration_seconds = 10.0;
+    /// Target operations per second of every thread, 0 means as fast as possible
+    double rate = 0.0;
+    std::array<unsigned int, operation_count> mix{{40, 30, 20, 10}};
+    std::string read_variable = "config.limit";
+    std::string write_variable = "stats.counter";
+    std::string lua_function = "handle";
+    std::string callback_function = "handle_with_callback";
+};
+
+using luabz::latency_histogram;
+
+using worker_histograms = std::array<latency_histogram, operation_count>;
+
+void print_usage(const char* program)
+{
+    std::printf("Usage: %s [options]\n"
+                "  --script=PATH           Lua script to load (default src/scripts/loadgen.lua)\n"
+                "  --threads=N             Number of threads, each owning a lua state (default 4)\n"
+                "  --duration=SECONDS      Duration of the run (default 10)\n"
+                "  --rate=OPS              Target operations per second per thread, 0 = unbounded\n"
+                "  --mix=R,W,L,C           Weights of reads, writes, lua calls and C++ callbacks\n"
+                "  --read=NAME             Variable read by read operations (default config.limit)\n"
+                "  --write=NAME            Variable written by write operations (default "
+                "stats.counter)\n"
+                "  --function=NAME         Lua function used by lua calls (default handle)\n"
+                "  --callback-function=NAME Lua function calling cpp_callback (default "
+                "handle_with_callback)\n",
+                program);
+}
+
+bool parse_mix(const std::string& text, std::array<unsigned int, operation_count>& mix)
+{
+    std::size_t position = 0;
+    for (std::size_t i = 0; i < operation_count; ++i) {
+        std::size_t next = text.find(',', position);
+        bool last = (i + 1 == operation_count);
+        if ((next == std::string::npos) != last) {
+            return false;
+        }
+        mix[i] = static_cast<unsigned int>(std::stoul(text.substr(position, next - position)));
+        position = next + 1;
+    }
+    return std::any_of(mix.begin(), mix.end(), [](unsigned int weight) { return weight != 0; });
+}
+
+bool parse_arguments(int argc, char** argv, options& opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        auto separator = argument.find('=');
+        std::string name = argument.substr(0, separator);
+        std::string value = (separator == std::string::npos) ? "" : argument.substr(separator + 1);
+        if (name == "--script") {
+            opts.script_path = value;
+        } else if (name == "--threads") {
+            opts.threads = std::max<std::size_t>(1, std::stoul(value));
+        } else if (name == "--duration") {
+            opts.duration_seconds = std::stod(value);
+        } else if (name == "--rate") {
+            opts.rate = std::stod(value);
+        } else if (name == "--mix") {
+            if (!parse_mix(value, opts.mix)) {
+                return false;
+            }
+        } else if (name == "--read") {
+            opts.read_variable = value;
+        } else if (name == "--write") {
+            opts.write_variable = value;
+        } else if (name == "--function") {
+            opts.lua_function = value;
+        } else if (name == "--callback-function") {
+            opts.callback_function = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parse_options(int argc, char** argv, options& opts)
+{
+    try {
+        return parse_arguments(argc, argv, opts);
+    } catch (const std::logic_error&) {
+        // std::stoul and std::stod throw invalid_argument or out_of_range on malformed numbers
+        return false;
+    }
+}
+
+void run_worker(const options& opts,
+                std::size_t worker_index,
+                const std::atomic<bool>& running,
+                worker_histograms& histograms)
+{
+    luabz::script script{opts.script_path, luabz::unique_state, true};
+    script["cpp_callback"].assign([](int value) { return value * 2; });
+
+    std::mt19937 generator{static_cast<std::mt19937::result_type>(worker_index)};
+    std::discrete_distribution<std::size_t> pick_operation(opts.mix.begin(), opts.mix.end());
+    const bool rate_limited = opts.rate > 0.0;
+    const auto interval = std::chrono::duration_cast<clock_type::duration>(
+        std::chrono::duration<double>(rate_limited ? 1.0 / opts.rate : 0.0));
+    auto scheduled = clock_type::now();
+    int iteration = 0;
+
+    while (running.load(std::memory_order_relaxed)) {
+        if (rate_limited) {
+            std::this_thread::sleep_until(scheduled);
+        }
+        // When rate limited the latency is measured from the scheduled start, so a slow
+        // operation is not hidden by the ones that could not be issued in the meantime
+        auto start = rate_limited ? scheduled : clock_type::now();
+        auto op = static_cast<operation>(pick_operation(generator));
+        ++iteration;
+        switch (op) {
+            case read: {
+                int value = script[opts.read_variable];
+                static_cast<void>(value);
+                break;
+            }
+            case write:
+                script[opts.write_variable] = iteration;
+                break;
+            case lua_call:
+                script[opts.lua_function].call<int>(iteration);
+                break;
+            case cpp_callback:
+                script[opts.callback_function].call<int>(iteration);
+                break;
+            case operation_count:
+                break;
+        }
+        auto elapsed = clock_type::now() - start;
+        histograms[op].record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        scheduled += interval;
+    }
+    script.close();
+}
+
+void print_report(const worker_histograms& totals, double elapsed_seconds)
+{
+    std::printf("%-14s %12s %14s %10s %10s %10s %10s\n", "operation", "count", "ops/s",
+                "p50(us)", "p99(us)", "p999(us)", "max(us)");
+    latency_histogram all;
+    for (std::size_t i = 0; i < operation_count; ++i) {
+        const auto& histogram = totals[i];
+        all.merge(histogram);
+        std::printf("%-14s %12llu %14.0f %10.2f %10.2f %10.2f %10.2f\n", operation_names[i],
+                    static_cast<unsigned long long>(histogram.count()),
+                    static_cast<double>(histogram.count()) / elapsed_seconds,
+                    static_cast<double>(histogram.percentile(50.0)) / 1000.0,
+                    static_cast<double>(histogram.percentile(99.0)) / 1000.0,
+                    static_cast<double>(histogram.percentile(99.9)) / 1000.0,
+                    static_cast<double>(histogram.max()) / 1000.0);
+    }
+    std::printf("%-14s %12llu %14.0f %10.2f %10.2f %10.2f %10.2f\n", "total",
+                static_cast<unsigned long long>(all.count()),
+                static_cast<double>(all.count()) / elapsed_seconds,
+                static_cast<double>(all.percentile(50.0)) / 1000.0,
+                static_cast<double>(all.percentile(99.0)) / 1000.0,
+                static_cast<double>(all.percentile(99.9)) / 1000.0,
+                static_cast<double>(all.max()) / 1000.0);
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    options opts;
+    if (!parse_options(argc, argv, opts)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::atomic<bool> running{true};
+    std::vector<worker_histograms> histograms(opts.threads);
+    std::vector<std::thread> workers;
+    workers.reserve(opts.threads);
+    auto start = clock_type::now();
+    for (std::size_t i = 0; i < opts.threads; ++i) {
+        workers.emplace_back(run_worker, std::cref(opts), i, std::cref(running),
+                             std::ref(histograms[i]));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(opts.duration_seconds));
+    running.store(false, std::memory_order_relaxed);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = clock_type::now() - start;
+
+    worker_histograms totals;
+    for (const auto& worker_histogram : histograms) {
+        for (std::size_t i = 0; i < operation_count; ++i) {
+            totals[i].merge(worker_histogram[i]);
+        }
+    }
+    std::printf("script: %s, threads: %zu, elapsed: %.2fs\n", opts.script_path.c_str(),
+                opts.threads, elapsed.count());
+    print_report(totals, elapsed.count());
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,25 @@
+--Default script used by the luabz load generator
+config={
+    limit=100,
+    ratio=0.5,
+    name="loadgen"
+};
+stats={
+    counter=0,
+    handled=0
+};
+
+function handle(value)
+    local parts={};
+    local total=0;
+    for i=1,16 do
+        parts[i]=value%i;
+        total=total+parts[i];
+    end
+    stats.handled=stats.handled+1;
+    return total;
+end
+
+function handle_with_callback(value)
+    return cpp_callback(value)+1;
+end
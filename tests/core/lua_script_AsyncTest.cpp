@@ -0,0 +1,85 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <future>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class script_Async : public ::testing::Test
+{
+  public:
+    luabz::async_script script{construct_script_path("luascript_test.lua"), false, 8};
+};
+TEST_F(script_Async, CallReturnsAFuture)
+{
+    auto result = script.call<int>("single_return", 5);
+    ASSERT_EQ(5, result.get());
+}
+TEST_F(script_Async, VoidCall)
+{
+    auto result = script.call<void>("multiple_returns", 1, 2);
+    result.get();
+    ASSERT_EQ(0U, script.pending());
+}
+TEST_F(script_Async, SubmitRunsTasksOnTheScript)
+{
+    auto result = script.submit([](luabz::script& target) {
+        target["integer_var"] = 5;
+        return static_cast<int>(target["integer_var"]);
+    });
+    ASSERT_EQ(5, result.get());
+}
+TEST_F(script_Async, RequestsRunInSubmissionOrder)
+{
+    script.submit([](luabz::script& target) { target["integer_var"] = 1; });
+    script.submit([](luabz::script& target) { target("integer_var = integer_var * 10"); });
+    auto result = script.submit([](luabz::script& target) {
+        return static_cast<int>(target["integer_var"]);
+    });
+    ASSERT_EQ(10, result.get());
+}
+TEST_F(script_Async, ManyThreadsSubmitConcurrently)
+{
+    constexpr int threads_count = 4;
+    constexpr int calls_count = 1000;
+    std::vector<std::thread> threads;
+    std::vector<long long> sums(threads_count, 0);
+    for (int t = 0; t < threads_count; ++t) {
+        threads.emplace_back([this, t, &sums] {
+            std::vector<std::future<int>> results;
+            for (int i = 0; i < calls_count; ++i) {
+                results.push_back(script.call<int>("single_return", i));
+            }
+            for (auto& result : results) {
+                sums[t] += result.get();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto sum : sums) {
+        ASSERT_EQ(calls_count * (calls_count - 1) / 2, sum);
+    }
+}
+TEST_F(script_Async, StopRunsThePendingRequests)
+{
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 100; ++i) {
+        results.push_back(script.call<int>("single_return", i));
+    }
+    script.stop();
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(i, results[i].get());
+    }
+    auto dropped = script.call<int>("single_return", 1);
+    ASSERT_THROW(dropped.get(), std::future_error);
+}
+#ifdef LUABZ_USE_CPP_EXCEPTIONS
+TEST_F(script_Async, ErrorsAreRethrownByTheFuture)
+{
+    auto result = script.call<int>("integer_var.x.y");
+    ASSERT_THROW(result.get(), luabz::luabz_exception);
+}
+#endif
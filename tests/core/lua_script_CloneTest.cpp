@@ -0,0 +1,83 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <tuple>
+
+class script_Clone : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua"), luabz::unique_state};
+    void SetUp() override
+    {
+        script("lookup = {}"
+               "for i = 1, 100 do lookup[i] = i * i end "
+               "config = {name = 'tenant', limits = {cpu = 2}} "
+               "config.self = config "
+               "function square(i) return lookup[i] end "
+               "local hidden = 5 "
+               "function with_upvalue() return hidden end");
+    }
+    void TearDown() override { script.close(); }
+};
+TEST_F(script_Clone, CloneHasTheGlobals)
+{
+    auto clone = script.clone();
+    ASSERT_EQ(100, static_cast<int>(clone["integer_var"]));
+    std::string text = clone["string_var"];
+    ASSERT_EQ("This is some string", text);
+    ASSERT_TRUE(static_cast<bool>(clone["TableLevelOne.TableLevelTwo.x"]));
+    ASSERT_EQ(2, static_cast<int>(clone["config.self.limits.cpu"]));
+    clone.close();
+}
+TEST_F(script_Clone, FunctionsAreCopiedAsBytecode)
+{
+    auto clone = script.clone();
+    ASSERT_EQ(7, std::get<0>(clone["single_return"].call<int>(7)));
+    ASSERT_EQ(81, std::get<0>(clone["square"].call<int>(9)));
+    clone.close();
+}
+TEST_F(script_Clone, FunctionsWithUpvaluesAreNotCopied)
+{
+    auto clone = script.clone();
+    ASSERT_EQ(5, std::get<0>(script["with_upvalue"].call<int>()));
+    ASSERT_FALSE(clone["with_upvalue"]);
+    clone.close();
+}
+TEST_F(script_Clone, ClonesAreIsolated)
+{
+    auto first = script.clone();
+    auto second = script.clone();
+    first["integer_var"] = 1;
+    first("lookup[9] = 0");
+    ASSERT_EQ(100, static_cast<int>(second["integer_var"]));
+    ASSERT_EQ(100, static_cast<int>(script["integer_var"]));
+    ASSERT_EQ(81, std::get<0>(second["square"].call<int>(9)));
+    ASSERT_EQ(0, std::get<0>(first["square"].call<int>(9)));
+    second.close();
+    first.close();
+}
+TEST_F(script_Clone, GlobalsAreCapturedOnTheFirstClone)
+{
+    auto before = script.clone();
+    script["integer_var"] = 7;
+    auto captured = script.clone();
+    ASSERT_EQ(100, static_cast<int>(captured["integer_var"]));
+    script.refresh_template();
+    auto refreshed = script.clone();
+    ASSERT_EQ(7, static_cast<int>(refreshed["integer_var"]));
+    refreshed.close();
+    captured.close();
+    before.close();
+}
+TEST_F(script_Clone, CloneOfAStateWithTheStd)
+{
+    luabz::script with_std{construct_script_path("luascript_test.lua"), luabz::unique_state,
+                           true};
+    with_std("function shout(text) return string.upper(text) end");
+    auto clone = with_std.clone();
+    ASSERT_EQ("ABC", std::get<0>(clone["shout"].call<std::string>(std::string{"abc"})));
+    ASSERT_EQ(100, static_cast<int>(clone["integer_var"]));
+    clone.close();
+    with_std.close();
+}
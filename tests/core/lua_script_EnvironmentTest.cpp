@@ -0,0 +1,88 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <tuple>
+
+class script_Environment : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua"), luabz::unique_state, true};
+    void SetUp() override
+    {
+        script("function has_tenant() return tenant ~= nil end "
+               "function read_tenant() return tenant end "
+               "function store_tenant(name) tenant = name end");
+    }
+    void TearDown() override { script.close(); }
+};
+TEST_F(script_Environment, AssignedGlobalsStayInTheEnvironment)
+{
+    auto env = script.acquire_environment();
+    script("integer_var = 1 tenant = 'first'", env);
+    ASSERT_EQ(100, static_cast<int>(script["integer_var"]));
+    ASSERT_FALSE(std::get<0>(script["has_tenant"].call<bool>()));
+    ASSERT_EQ("first", std::get<0>(script["read_tenant"].call<std::string>(env)));
+}
+TEST_F(script_Environment, GlobalsFallBackToTheBase)
+{
+    auto env = script.acquire_environment();
+    script("tenant = integer_var + 1", env);
+    ASSERT_EQ(101, std::get<0>(script["read_tenant"].call<int>(env)));
+}
+TEST_F(script_Environment, EnvironmentsAreIsolated)
+{
+    auto first = script.acquire_environment();
+    auto second = script.acquire_environment();
+    script["store_tenant"].call<>(first, std::string{"first"});
+    script["store_tenant"].call<>(second, std::string{"second"});
+    ASSERT_EQ("first", std::get<0>(script["read_tenant"].call<std::string>(first)));
+    ASSERT_EQ("second", std::get<0>(script["read_tenant"].call<std::string>(second)));
+    ASSERT_FALSE(std::get<0>(script["has_tenant"].call<bool>()));
+}
+TEST_F(script_Environment, FunctionsDefinedInTheEnvironment)
+{
+    auto env = script.acquire_environment();
+    script("function single_return(i) return i * 2 end result = single_return(4)", env);
+    ASSERT_EQ(4, std::get<0>(script["single_return"].call<int>(4)));
+    script("tenant = result", env);
+    ASSERT_EQ(8, std::get<0>(script["read_tenant"].call<int>(env)));
+}
+TEST_F(script_Environment, ReleasedEnvironmentsAreEmpty)
+{
+    auto env = script.acquire_environment();
+    script("tenant = 'first' setmetatable(_ENV or getfenv(1), nil)", env);
+    env.release();
+    ASSERT_FALSE(env);
+    auto recycled = script.acquire_environment();
+    ASSERT_FALSE(std::get<0>(script["has_tenant"].call<bool>(recycled)));
+    script("tenant = integer_var", recycled);
+    ASSERT_EQ(100, std::get<0>(script["read_tenant"].call<int>(recycled)));
+}
+TEST_F(script_Environment, HandlesOutlivingTheStateAreDisarmed)
+{
+    luabz::script owner{construct_script_path("luascript_test.lua"), luabz::unique_state};
+    auto env = owner.acquire_environment();
+    ASSERT_TRUE(static_cast<bool>(env));
+    owner.close();
+    ASSERT_FALSE(env);
+    env.release();
+}
+TEST_F(script_Environment, ForeignOrReleasedEnvironmentsAreRejected)
+{
+    luabz::script other{construct_script_path("luascript_test.lua"), luabz::unique_state};
+    auto foreign = other.acquire_environment();
+    auto released = script.acquire_environment();
+    released.release();
+#ifdef LUABZ_USE_CPP_EXCEPTIONS
+    ASSERT_THROW(script("tenant = 'foreign'", foreign), luabz::luabz_exception);
+    ASSERT_THROW(script("tenant = 'released'", released), luabz::luabz_exception);
+    ASSERT_THROW(script["store_tenant"].call<>(foreign, "foreign"), luabz::luabz_exception);
+#else
+    script("tenant = 'foreign'", foreign);
+    script("tenant = 'released'", released);
+    script["store_tenant"].call<>(foreign, "foreign");
+#endif
+    ASSERT_FALSE(std::get<0>(script["has_tenant"].call<bool>()));
+    other.close();
+}
@@ -0,0 +1,121 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+struct Sample {
+    int id;
+    double reading;
+};
+LUABZ_FIELDS(Sample, id, reading);
+
+class script_EventQueue : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua"), luabz::unique_state};
+    void SetUp() override
+    {
+        script("received = 0 calls = 0 "
+               "function on_events(events) "
+               "  calls = calls + 1 "
+               "  for i = 1, #events do received = received + events[i] end "
+               "end "
+               "function on_event(event) calls = calls + 1 received = received + event end "
+               "function on_sample(sample) calls = calls + 1 received = received + sample.id end");
+    }
+    void TearDown() override { script.close(); }
+};
+TEST_F(script_EventQueue, QueueIsBoundedAndOrdered)
+{
+    luabz::mpsc_queue<int> queue{4};
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queue.try_push(i));
+    }
+    ASSERT_FALSE(queue.try_push(4));
+    int event = -1;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queue.try_pop(event));
+        ASSERT_EQ(i, event);
+    }
+    ASSERT_FALSE(queue.try_pop(event));
+    ASSERT_TRUE(queue.try_push(4));
+}
+TEST_F(script_EventQueue, CapacityIsRoundedUpToAPowerOfTwo)
+{
+    luabz::mpsc_queue<int> queue{5};
+    ASSERT_EQ(8U, queue.capacity());
+}
+TEST_F(script_EventQueue, ManyProducersOneConsumer)
+{
+    constexpr int producers_count = 4;
+    constexpr int events_count = 10000;
+    luabz::mpsc_queue<int> queue{64};
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producers_count; ++p) {
+        producers.emplace_back([&queue] {
+            for (int i = 1; i <= events_count; ++i) {
+                while (!queue.try_push(i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    long long sum = 0;
+    int event = 0;
+    for (int popped = 0; popped < producers_count * events_count;) {
+        if (queue.try_pop(event)) {
+            sum += event;
+            ++popped;
+        }
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    ASSERT_EQ(producers_count * (events_count * (events_count + 1LL) / 2), sum);
+}
+TEST_F(script_EventQueue, BatchDispatch)
+{
+    luabz::mpsc_queue<int> queue{128};
+    for (int i = 1; i <= 100; ++i) {
+        queue.try_push(i);
+    }
+    luabz::event_dispatcher<int> dispatcher{script, "on_events", queue,
+                                            luabz::dispatch_mode::batch, 32};
+    ASSERT_EQ(100U, dispatcher.drain_all());
+    ASSERT_EQ(5050, static_cast<int>(script["received"]));
+    ASSERT_EQ(4, static_cast<int>(script["calls"]));
+    ASSERT_EQ(0U, dispatcher.drain());
+}
+TEST_F(script_EventQueue, PerEventDispatch)
+{
+    luabz::mpsc_queue<int> queue{128};
+    for (int i = 1; i <= 100; ++i) {
+        queue.try_push(i);
+    }
+    luabz::event_dispatcher<int> dispatcher{script, "on_event", queue,
+                                            luabz::dispatch_mode::per_event, 64};
+    ASSERT_EQ(64U, dispatcher.drain());
+    ASSERT_EQ(36U, dispatcher.drain());
+    ASSERT_EQ(5050, static_cast<int>(script["received"]));
+    ASSERT_EQ(100, static_cast<int>(script["calls"]));
+}
+TEST_F(script_EventQueue, AggregateEvents)
+{
+    luabz::mpsc_queue<Sample> queue{16};
+    queue.try_push(Sample{3, 0.5});
+    queue.try_push(Sample{4, 1.5});
+    luabz::event_dispatcher<Sample> dispatcher{script, "on_sample", queue,
+                                               luabz::dispatch_mode::per_event};
+    ASSERT_EQ(2U, dispatcher.drain_all());
+    ASSERT_EQ(7, static_cast<int>(script["received"]));
+}
+TEST_F(script_EventQueue, DispatcherOutlivingTheScriptIsDisarmed)
+{
+    luabz::mpsc_queue<int> queue{8};
+    luabz::event_dispatcher<int> dispatcher{script, "on_event", queue,
+                                            luabz::dispatch_mode::per_event};
+    queue.try_push(1);
+    script.close();
+    ASSERT_EQ(0U, dispatcher.drain());
+}
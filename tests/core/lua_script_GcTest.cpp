@@ -0,0 +1,96 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+
+class script_Gc : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua"), luabz::unique_state};
+    void TearDown() override { script.close(); }
+    void make_garbage()
+    {
+        script("for i = 1, 20000 do garbage = {i, i} end garbage = nil");
+    }
+};
+TEST_F(script_Gc, MemoryIsReported)
+{
+    ASSERT_GT(script.gc().memory(), 0u);
+}
+TEST_F(script_Gc, CollectReleasesGarbage)
+{
+    auto gc = script.gc();
+    gc.stop();
+    make_garbage();
+    std::size_t before = gc.memory();
+    gc.collect();
+    ASSERT_LT(gc.memory(), before);
+    ASSERT_EQ(1u, gc.stats().collections);
+}
+TEST_F(script_Gc, StopAndRestart)
+{
+    auto gc = script.gc();
+    ASSERT_TRUE(gc.is_running());
+    gc.stop();
+    ASSERT_FALSE(gc.is_running());
+    gc.restart();
+    ASSERT_TRUE(gc.is_running());
+}
+TEST_F(script_Gc, SettersReturnThePreviousValue)
+{
+    auto gc = script.gc();
+    gc.set_pause(160);
+    ASSERT_EQ(160, gc.set_pause(200));
+    gc.set_step_multiplier(300);
+    ASSERT_EQ(300, gc.set_step_multiplier(200));
+}
+TEST_F(script_Gc, StepForRunsUntilTheCycleEnds)
+{
+    auto gc = script.gc();
+    gc.stop();
+    make_garbage();
+    luabz::gc_step_result result = gc.step_for(std::chrono::seconds{10});
+    ASSERT_TRUE(result.cycle_finished);
+    ASSERT_GT(result.steps, 0u);
+    ASSERT_EQ(result.steps, gc.stats().steps);
+    ASSERT_EQ(1u, gc.stats().cycles);
+}
+TEST_F(script_Gc, EmptyBudgetRunsNoStep)
+{
+    luabz::gc_step_result result = script.gc().step_for(std::chrono::nanoseconds{0});
+    ASSERT_EQ(0u, result.steps);
+    ASSERT_FALSE(result.cycle_finished);
+}
+TEST_F(script_Gc, GenerationalModeMatchesTheLuaVersion)
+{
+    auto gc = script.gc();
+#if LUABZ_LUA_VERSION >= 504 || LUABZ_LUA_VERSION == 502
+    ASSERT_TRUE(gc.set_mode(luabz::gc_mode::generational));
+#else
+    ASSERT_FALSE(gc.set_mode(luabz::gc_mode::generational));
+#endif
+    ASSERT_TRUE(gc.set_mode(luabz::gc_mode::incremental));
+}
+TEST_F(script_Gc, StatsAreDumped)
+{
+    script.gc().collect();
+    std::string json = script.gc().dump_stats(luabz::metrics_format::json);
+    ASSERT_NE(std::string::npos, json.find("\"collections\":1"));
+}
+TEST_F(script_Gc, StaysStoppedAfterRequestedWork)
+{
+    auto gc = script.gc();
+    gc.stop();
+    gc.step();
+    gc.step_for(std::chrono::microseconds{200});
+    gc.collect();
+    ASSERT_FALSE(gc.is_running());
+    std::size_t before = gc.memory();
+    make_garbage();
+    std::size_t after_first = gc.memory();
+    // Each garbage table takes more than 32 bytes, a running collector would reclaim them
+    ASSERT_GT(after_first, before + 20000 * 32);
+    make_garbage();
+    ASSERT_GT(gc.memory(), after_first + 20000 * 32);
+}
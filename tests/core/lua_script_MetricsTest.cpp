@@ -0,0 +1,62 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class script_Metrics : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua")};
+    void TearDown() override { script.close(); }
+};
+TEST_F(script_Metrics, RecordsOfSeveralThreadsAreMerged)
+{
+    lua_State* state = luabz::state::get(construct_script_path("luascript_test.lua"));
+    std::vector<std::thread> recorders;
+    for (int i = 0; i < 4; ++i) {
+        recorders.emplace_back([state]() {
+            for (int call = 0; call < 100; ++call) {
+                luabz::metrics::record(state, luabz::call_kind::cpp_function, "threaded", 10, 5);
+            }
+        });
+    }
+    for (auto& recorder : recorders) {
+        recorder.join();
+    }
+    std::string report = script.dump_metrics(luabz::metrics_format::json);
+    ASSERT_NE(std::string::npos,
+              report.find("{\"name\":\"threaded\",\"kind\":\"cpp_function\",\"count\":400,"
+                          "\"total_ns\":4000,\"inner_ns\":2000"));
+}
+#ifdef LUABZ_ENABLE_INSTRUMENTATION
+TEST_F(script_Metrics, LuaFunctionCallsAreCounted)
+{
+    script["single_return"].call<int>(1);
+    script["single_return"].call<int>(2);
+    std::string report = script.dump_metrics(luabz::metrics_format::json);
+    ASSERT_NE(std::string::npos,
+              report.find("{\"name\":\"single_return\",\"kind\":\"lua_function\",\"count\":2"));
+}
+TEST_F(script_Metrics, CppCallbacksAreCounted)
+{
+    script["lambda"].assign([](int a) { return a; });
+    script("result=lambda(1)");
+    std::string report = script.dump_metrics(luabz::metrics_format::json);
+    ASSERT_NE(std::string::npos,
+              report.find("{\"name\":\"lambda\",\"kind\":\"cpp_function\",\"count\":1"));
+}
+TEST_F(script_Metrics, TextReportContainsOneLinePerFunction)
+{
+    script["single_return"].call<int>(1);
+    std::string report = script.dump_metrics();
+    ASSERT_NE(std::string::npos, report.find("single_return"));
+}
+#else
+TEST_F(script_Metrics, NothingIsRecordedWhenInstrumentationIsDisabled)
+{
+    script["single_return"].call<int>(1);
+    ASSERT_EQ("{\"functions\":[]}", script.dump_metrics(luabz::metrics_format::json));
+}
+#endif
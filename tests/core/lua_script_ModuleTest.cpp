@@ -0,0 +1,74 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+class script_Module : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua"), luabz::unique_state, true};
+    void SetUp() override
+    {
+        luabz::module_registry::add("luabz_test.math",
+                                    "local M = {} "
+                                    "function M.square(x) return x * x end "
+                                    "return M");
+        luabz::module_registry::add("luabz_test.main",
+                                    "local math_module = require('luabz_test.math') "
+                                    "squared = math_module.square(integer or 3)");
+        luabz::module_registry::add_file("luabz_test.dep", construct_script_path("luascript_dep"));
+    }
+    void TearDown() override
+    {
+        script.close();
+        luabz::module_registry::remove("luabz_test.math");
+        luabz::module_registry::remove("luabz_test.main");
+        luabz::module_registry::remove("luabz_test.dep");
+    }
+};
+TEST_F(script_Module, RequireResolvesRegisteredSources)
+{
+    script("squared = require('luabz_test.math').square(4)");
+    ASSERT_EQ(16, static_cast<int>(script["squared"]));
+}
+TEST_F(script_Module, RequireResolvesRegisteredFiles)
+{
+    ASSERT_TRUE(luabz::module_registry::contains("luabz_test.dep"));
+    script("require('luabz_test.dep')");
+    ASSERT_EQ(1, static_cast<int>(script["dep1_integer"]));
+}
+TEST_F(script_Module, RequireCachesTheModule)
+{
+    script("same = require('luabz_test.math') == require('luabz_test.math')");
+    bool same = script["same"];
+    ASSERT_TRUE(same);
+}
+TEST_F(script_Module, MissingModulesAreReported)
+{
+    script("ok, message = pcall(require, 'luabz_test.missing')");
+    ASSERT_FALSE(script["ok"]);
+    std::string message = script["message"];
+    ASSERT_NE(std::string::npos, message.find("luabz registry"));
+}
+TEST_F(script_Module, SyntaxErrorsAreRaisedByRequire)
+{
+    luabz::module_registry::add("luabz_test.broken", "return {");
+    script("ok, message = pcall(require, 'luabz_test.broken')");
+    luabz::module_registry::remove("luabz_test.broken");
+    ASSERT_FALSE(script["ok"]);
+    std::string message = script["message"];
+    ASSERT_NE(std::string::npos, message.find("luabz_test.broken"));
+}
+TEST_F(script_Module, PreloadKeepsThePrecedence)
+{
+    script("package.preload['luabz_test.math'] = function() return 'preloaded' end "
+           "loaded = require('luabz_test.math')");
+    std::string loaded = script["loaded"];
+    ASSERT_EQ("preloaded", loaded);
+}
+TEST_F(script_Module, ScriptOpenedByModuleName)
+{
+    luabz::script main{luabz::from_module("luabz_test.main"), luabz::unique_state, true};
+    ASSERT_EQ(9, static_cast<int>(main["squared"]));
+    main.close();
+}
@@ -0,0 +1,77 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+class script_Preload : public ::testing::Test
+{
+  public:
+    const std::string temporary_path = std::string(P_tmpdir) + "/luabz_preload_test.lua";
+    void write_temporary(const std::string& content)
+    {
+        std::ofstream file{temporary_path, std::ios::trunc};
+        file << content;
+    }
+    void TearDown() override
+    {
+        luabz::state::discard_preloaded();
+        std::remove(temporary_path.c_str());
+    }
+};
+TEST_F(script_Preload, AllFilesAreCompiled)
+{
+    std::vector<std::string> paths{construct_script_path("luascript_test.lua"),
+                                   construct_script_path("luascript_dep.lua"),
+                                   construct_script_path("luascript_dep2.lua")};
+    ASSERT_EQ(paths.size(), luabz::state::preload(paths, 2));
+    for (const auto& path : paths) {
+        ASSERT_TRUE(luabz::state::is_preloaded(path));
+    }
+}
+TEST_F(script_Preload, PreloadedScriptRuns)
+{
+    const std::string path = construct_script_path("luascript_test.lua");
+    luabz::state::preload({path}, 1);
+    luabz::script script{path, luabz::unique_state};
+    ASSERT_EQ(100, static_cast<int>(script["integer_var"]));
+    script.close();
+}
+TEST_F(script_Preload, BytecodeIsUsedInsteadOfTheFile)
+{
+    write_temporary("value = 1");
+    luabz::state::preload({temporary_path}, 1);
+    write_temporary("value = 2");
+    luabz::script script{temporary_path, luabz::unique_state};
+    ASSERT_EQ(1, static_cast<int>(script["value"]));
+    script.close();
+}
+TEST_F(script_Preload, DiscardedFilesAreReadAgain)
+{
+    write_temporary("value = 1");
+    luabz::state::preload({temporary_path}, 1);
+    write_temporary("value = 2");
+    luabz::state::discard_preloaded();
+    ASSERT_FALSE(luabz::state::is_preloaded(temporary_path));
+    luabz::script script{temporary_path, luabz::unique_state};
+    ASSERT_EQ(2, static_cast<int>(script["value"]));
+    script.close();
+}
+TEST_F(script_Preload, FailedFilesAreSkipped)
+{
+    write_temporary("value = = 1");
+    std::vector<std::string> paths{construct_script_path("luascript_test.lua"), temporary_path};
+#ifdef LUABZ_USE_CPP_EXCEPTIONS
+    ASSERT_THROW(luabz::state::preload(paths, 2), luabz::luabz_exception);
+#else
+    ASSERT_EQ(1u, luabz::state::preload(paths, 2));
+#endif
+    ASSERT_TRUE(luabz::state::is_preloaded(paths[0]));
+    ASSERT_FALSE(luabz::state::is_preloaded(temporary_path));
+}
+TEST_F(script_Preload, NoFilesIsNoop)
+{
+    ASSERT_EQ(0u, luabz::state::preload({}, 4));
+}
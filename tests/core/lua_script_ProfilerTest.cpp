@@ -0,0 +1,50 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+class script_Profiler : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua")};
+    void TearDown() override { script.close(); }
+};
+TEST_F(script_Profiler, SamplesContainTheRunningLuaFunction)
+{
+    luabz::profiler profiler{script, 100};
+    profiler.start();
+    script["busy_loop"].call<int>(100000);
+    profiler.stop();
+    ASSERT_GT(profiler.samples(), 0U);
+    ASSERT_NE(std::string::npos, profiler.folded().find("busy_loop"));
+}
+TEST_F(script_Profiler, StoppedProfilerDoesNotSample)
+{
+    luabz::profiler profiler{script, 100};
+    script["busy_loop"].call<int>(100000);
+    ASSERT_EQ(0U, profiler.samples());
+    ASSERT_TRUE(profiler.folded().empty());
+}
+TEST_F(script_Profiler, FoldedStacksEndWithTheSampleCount)
+{
+    luabz::profiler profiler{script, 100};
+    profiler.start();
+    script["busy_loop"].call<int>(100000);
+    profiler.stop();
+    std::string folded = profiler.folded();
+    auto line_end = folded.find('\n');
+    auto count_start = folded.rfind(' ', line_end);
+    ASSERT_GT(std::stoul(folded.substr(count_start + 1, line_end - count_start - 1)), 0U);
+}
+#ifdef LUABZ_LUAJIT
+TEST_F(script_Profiler, CompiledLoopIsSampledUnderLuaJIT)
+{
+    script("function hot(n) local sum = 0 for i = 1, n do sum = sum + i end return sum end");
+    script["hot"].call<double>(100000);
+    luabz::profiler profiler{script, 100};
+    profiler.start();
+    script["hot"].call<double>(1000000);
+    profiler.stop();
+    ASSERT_GT(profiler.samples(), 0U);
+}
+#endif
@@ -0,0 +1,88 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+class script_Reader : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua"), luabz::unique_state};
+    lua_State* state = luaL_newstate();
+    const std::string temporary_path = std::string(P_tmpdir) + "/luabz_reader_test.lua";
+    void write_temporary(const std::string& content)
+    {
+        std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+        file << content;
+    }
+    std::string top_message() const
+    {
+        const char* message = lua_tostring(state, -1);
+        return message == nullptr ? std::string() : std::string(message);
+    }
+    void TearDown() override
+    {
+        std::remove(temporary_path.c_str());
+        lua_close(state);
+        script.close();
+    }
+};
+TEST_F(script_Reader, LoadFileRunsTheScript)
+{
+    ASSERT_EQ(0, luabz::load_file(state, construct_script_path("luascript_test.lua")));
+    ASSERT_EQ(0, lua_pcall(state, 0, 0, 0));
+    luabz::interface::get_global(state, "integer_var");
+    ASSERT_EQ(100, static_cast<int>(lua_tointeger(state, -1)));
+}
+TEST_F(script_Reader, FirstLineCommentIsSkipped)
+{
+    write_temporary("#!/usr/bin/env lua\nvalue = 1\nerror('third line')\n");
+    ASSERT_EQ(0, luabz::load_file(state, temporary_path));
+    ASSERT_NE(0, lua_pcall(state, 0, 0, 0));
+    ASSERT_NE(std::string::npos, top_message().find("luabz_reader_test.lua:3:"));
+}
+TEST_F(script_Reader, ByteOrderMarkIsSkipped)
+{
+    write_temporary("\xEF\xBB\xBF#!/usr/bin/env lua\nvalue = 1\n");
+    ASSERT_EQ(0, luabz::load_file(state, temporary_path));
+    ASSERT_EQ(0, lua_pcall(state, 0, 0, 0));
+    luabz::interface::get_global(state, "value");
+    ASSERT_EQ(1, static_cast<int>(lua_tointeger(state, -1)));
+}
+TEST_F(script_Reader, ByteOrderMarkOnlyFileLoads)
+{
+    write_temporary("\xEF\xBB\xBF");
+    ASSERT_EQ(0, luabz::load_file(state, temporary_path));
+}
+TEST_F(script_Reader, EmptyFileLoads)
+{
+    write_temporary("");
+    ASSERT_EQ(0, luabz::load_file(state, temporary_path));
+}
+TEST_F(script_Reader, MissingFileIsReported)
+{
+    ASSERT_NE(0, luabz::load_file(state, temporary_path + ".missing"));
+}
+TEST_F(script_Reader, BufferReaderNamesTheChunk)
+{
+    const std::string chunk = "value = = 1";
+    luabz::buffer_reader reader{chunk.data(), chunk.size()};
+    ASSERT_NE(0, reader.load(state, "=generated"));
+    ASSERT_NE(std::string::npos, top_message().find("generated"));
+}
+TEST_F(script_Reader, RunBufferRunsInPlace)
+{
+    const std::string chunk = "buffered = integer_var + 1";
+    script.run_buffer(chunk.data(), chunk.size());
+    ASSERT_EQ(101, static_cast<int>(script["buffered"]));
+}
+TEST_F(script_Reader, RunBufferAcceptsBytecode)
+{
+    ASSERT_EQ(0, luaL_loadstring(state, "compiled = 7"));
+    std::vector<char> bytecode;
+    ASSERT_TRUE(luabz::interface::dump_function(state, bytecode));
+    script.run_buffer(bytecode.data(), bytecode.size(), "=compiled");
+    ASSERT_EQ(7, static_cast<int>(script["compiled"]));
+}
@@ -2,6 +2,7 @@
 #include "luabz.hpp"
 #include <gtest/gtest.h>
 #include <iostream>
+#include <memory>
 #include <string>
 class scriptF : public ::testing::Test
 {
@@ -32,4 +33,27 @@ TEST_F(scriptF, CheckIfLuaStdIsCorrectlyLoaded)
     script("variable=math.floor(1213.23)");
     int variable = script["variable"];
     ASSERT_EQ(1213, variable);
-}
\ No newline at end of file
+}
+
+TEST_F(scriptF, MovedFromScriptDoesntCloseTheState)
+{
+    luabz::script source{construct_script_path("luascript_test.lua"), luabz::unique_state};
+    source("moved = 1");
+    luabz::script target{std::move(source)};
+    source.close();
+    int moved = target["moved"];
+    ASSERT_EQ(1, moved);
+    target.close();
+}
+TEST_F(scriptF, CallbacksOfAClosedStateAreReleased)
+{
+    auto counter = std::make_shared<int>(0);
+    {
+        luabz::script owner{construct_script_path("luascript_test.lua"), luabz::unique_state};
+        owner["count"].assign([counter]() { ++*counter; });
+        owner("count()");
+        owner.close();
+    }
+    ASSERT_EQ(1, *counter);
+    ASSERT_EQ(1, counter.use_count());
+}
@@ -0,0 +1,107 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <chrono>
+#include <exception>
+#include <gtest/gtest.h>
+#include <string>
+#include <tuple>
+
+class value_Budget : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua")};
+    void SetUp() override { script("function spin() while true do end end"); }
+    void TearDown() override { script.close(); }
+};
+TEST_F(value_Budget, CallWithinBudgetReturnsTheResult)
+{
+    auto result = script["single_return"].call<int>(luabz::budget::instructions_limit(1000), 5);
+    ASSERT_EQ(5, std::get<0>(result));
+}
+TEST_F(value_Budget, LvalueBudgetIsNotPassedAsArgument)
+{
+    luabz::budget limit = luabz::budget::time_limit(std::chrono::seconds(10));
+    int result = script["single_return"](limit, 7);
+    ASSERT_EQ(7, result);
+}
+#ifdef LUABZ_USE_CPP_EXCEPTIONS
+TEST_F(value_Budget, InstructionBudgetInterruptsInfiniteLoop)
+{
+    try {
+        script["spin"].call<>(luabz::budget::instructions_limit(10000));
+        FAIL();
+    } catch (const luabz::luabz_exception& e) {
+        ASSERT_EQ(luabz::error_kind::budget_exceeded, e.kind());
+    }
+}
+TEST_F(value_Budget, DeadlineInterruptsInfiniteLoop)
+{
+    try {
+        script["spin"].call<>(luabz::budget::time_limit(std::chrono::milliseconds(10)));
+        FAIL();
+    } catch (const luabz::luabz_exception& e) {
+        ASSERT_EQ(luabz::error_kind::budget_exceeded, e.kind());
+    }
+}
+TEST_F(value_Budget, ScriptCodeIsInterruptedByBudget)
+{
+    try {
+        script("while true do end", luabz::budget::instructions_limit(10000));
+        FAIL();
+    } catch (const luabz::luabz_exception& e) {
+        ASSERT_EQ(luabz::error_kind::budget_exceeded, e.kind());
+    }
+}
+#else
+TEST_F(value_Budget, InstructionBudgetInterruptsInfiniteLoop)
+{
+    script["spin"].call<>(luabz::budget::instructions_limit(10000));
+    SUCCEED();
+}
+TEST_F(value_Budget, DeadlineInterruptsInfiniteLoop)
+{
+    script["spin"].call<>(luabz::budget::time_limit(std::chrono::milliseconds(10)));
+    SUCCEED();
+}
+#endif
+TEST_F(value_Budget, HookIsRemovedAfterTheCall)
+{
+    script["single_return"].call<int>(luabz::budget::instructions_limit(1000), 1);
+    auto result = script["busy_loop"].call<int>(10000);
+    ASSERT_GT(std::get<0>(result), 0);
+}
+TEST_F(value_Budget, InstructionBudgetIsExact)
+{
+    auto count_until_interrupted = [this](std::size_t instructions) {
+        try {
+            script("count = 0 while true do count = count + 1 end",
+                   luabz::budget::instructions_limit(instructions));
+        } catch (const std::exception&) {
+        }
+        return static_cast<int>(script["count"]);
+    };
+    // Both ran up to 2000 instructions when the hook fired only every 1000
+    ASSERT_LT(count_until_interrupted(1500), count_until_interrupted(2000));
+}
+TEST_F(value_Budget, BudgetedScriptCodeKeepsTheStackBalanced)
+{
+    lua_State* state = luabz::state::get(construct_script_path("luascript_test.lua"));
+    int top = lua_gettop(state);
+    script("return 1, 2, 3", luabz::budget::instructions_limit(1000));
+    try {
+        script("while true do end", luabz::budget::instructions_limit(1000));
+    } catch (const std::exception&) {
+    }
+    ASSERT_EQ(top, lua_gettop(state));
+}
+#ifdef LUABZ_LUAJIT
+TEST_F(value_Budget, CompiledLoopIsInterruptedUnderLuaJIT)
+{
+    script("function hot(n) for i = 1, n do progress = i end end hot(100000)");
+    try {
+        script["hot"].call<>(luabz::budget::instructions_limit(100000), 100000000);
+    } catch (const std::exception&) {
+    }
+    ASSERT_LT(static_cast<int>(script["progress"]), 100000000);
+}
+#endif
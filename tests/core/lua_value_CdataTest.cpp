@@ -0,0 +1,64 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+
+#if defined(LUABZ_LUAJIT) && LUAJIT_VERSION_NUM >= 20100
+struct Point {
+    double x;
+    double y;
+};
+
+class value_Cdata : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua"), true};
+    void SetUp() override
+    {
+        script("ffi = require('ffi') "
+               "ffi.cdef('typedef struct { double x; double y; } point_t;') "
+               "numbers = ffi.new('double[4]', {1.5, 2.5, 3.5, 4.5}) "
+               "point = ffi.new('point_t', {3, 4})");
+    }
+    void TearDown() override { script.close(); }
+};
+TEST_F(value_Cdata, ArrayIsSharedWithoutConversion)
+{
+    luabz::cdata<double> numbers = script["numbers"];
+    ASSERT_DOUBLE_EQ(2.5, numbers[1]);
+    numbers[1] = 10.0;
+    script("second = numbers[1]");
+    double second = script["second"];
+    ASSERT_DOUBLE_EQ(10.0, second);
+}
+TEST_F(value_Cdata, Struct)
+{
+    luabz::cdata<Point> point = script["point"];
+    ASSERT_DOUBLE_EQ(3.0, point->x);
+    ASSERT_DOUBLE_EQ(4.0, point->y);
+}
+TEST_F(value_Cdata, PointerIsPassedToLua)
+{
+    double values[2] = {7.0, 8.0};
+    script["values"] = luabz::cdata<double>{values};
+    script("values = ffi.cast('double*', values) values[0] = values[0] + values[1]");
+    ASSERT_DOUBLE_EQ(15.0, values[0]);
+}
+TEST_F(value_Cdata, PointerCdataIsRejected)
+{
+    script("numbers_pointer = ffi.cast('double *', numbers)");
+    auto result = script["numbers_pointer"].try_get<luabz::cdata<double>>();
+    ASSERT_FALSE(result.has_value());
+}
+TEST_F(value_Cdata, Int64CdataIsNotAPointer)
+{
+    script("big = 1LL");
+    auto result = script["big"].try_get<luabz::cdata<long long>>();
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(1, *result.value());
+}
+TEST_F(value_Cdata, NumberIsNotCdata)
+{
+    auto result = script["integer_var"].try_get<luabz::cdata<double>>();
+    ASSERT_FALSE(result.has_value());
+}
+#endif
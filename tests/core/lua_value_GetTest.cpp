@@ -72,4 +72,24 @@ TEST_F(value_Get, LuaNumberAsCppFloat)
 {
     float double_var = script["double_var"];
     ASSERT_FLOAT_EQ(102.0351f, double_var);
-}
\ No newline at end of file
+}
+TEST_F(value_Get, CheckedPolicyIsTheDefault)
+{
+    int checked = script["integer_var"].get<int>();
+    int explicit_checked = script["integer_var"].get<int, luabz::checked>();
+    ASSERT_EQ(100, checked);
+    ASSERT_EQ(100, explicit_checked);
+}
+TEST_F(value_Get, UncheckedPolicyReadsTheValue)
+{
+    ASSERT_EQ(100, (script["integer_var"].get<int, luabz::unchecked>()));
+    ASSERT_DOUBLE_EQ(102.0351, (script["double_var"].get<double, luabz::unchecked>()));
+    ASSERT_EQ("This is some string",
+              (script["string_var"].get<std::string, luabz::unchecked>()));
+    ASSERT_TRUE((script["boolt_var"].get<bool, luabz::unchecked>()));
+}
+TEST_F(value_Get, UncheckedPolicyDoesNotRaiseOnMismatch)
+{
+    ASSERT_EQ(0, (script["string_var"].get<int, luabz::unchecked>()));
+    ASSERT_EQ("", (script["nil_var"].get<std::string, luabz::unchecked>()));
+}
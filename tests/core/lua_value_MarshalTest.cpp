@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <tuple>
+
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+class value_Marshal : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua"), luabz::unique_state, true};
+    void TearDown() override { script.close(); }
+};
+
+TEST_F(value_Marshal, VoidFunctionReturnsNothing)
+{
+    int seen = 0;
+    script["touch"].assign([&seen](int a) { seen = a; });
+    script("results_count = select('#', touch(5))");
+    ASSERT_EQ(5, seen);
+    ASSERT_EQ(0, static_cast<int>(script["results_count"]));
+}
+TEST_F(value_Marshal, TupleIsReturnedAsMultipleResults)
+{
+    script["split"].assign(
+        [](int a) { return std::make_tuple(a, a * 2, std::string("third")); });
+    script("first, second, third = split(3)");
+    ASSERT_EQ(3, static_cast<int>(script["first"]));
+    ASSERT_EQ(6, static_cast<int>(script["second"]));
+    std::string third = script["third"];
+    ASSERT_EQ("third", third);
+}
+TEST_F(value_Marshal, ConstReferenceParameter)
+{
+    script["length"].assign([](const std::string& text) { return static_cast<int>(text.size()); });
+    script("text_length = length('abcdef')");
+    ASSERT_EQ(6, static_cast<int>(script["text_length"]));
+}
+TEST_F(value_Marshal, CStringParameterPointsIntoLua)
+{
+    script["length"].assign([](const char* text) { return static_cast<int>(std::strlen(text)); });
+    script("text_length = length('abcd')");
+    ASSERT_EQ(4, static_cast<int>(script["text_length"]));
+}
+#ifdef LUABZ_HAS_STRING_VIEW
+TEST_F(value_Marshal, StringViewParameterKeepsEmbeddedZeros)
+{
+    script["length"].assign(
+        [](std::string_view text) { return static_cast<int>(text.size()); });
+    script("text_length = length('ab\\0cd')");
+    ASSERT_EQ(5, static_cast<int>(script["text_length"]));
+}
+#endif
+TEST_F(value_Marshal, VariadicArgsReceiveTheRemainingArguments)
+{
+    script["sum"].assign([](int first, luabz::variadic_args rest) {
+        int total = first;
+        for (std::size_t i = 0; i < rest.size(); ++i) {
+            total += rest[i].get<int>();
+        }
+        return total;
+    });
+    script("all = sum(1, 2, 3, 4)");
+    script("only = sum(1)");
+    ASSERT_EQ(10, static_cast<int>(script["all"]));
+    ASSERT_EQ(1, static_cast<int>(script["only"]));
+}
+TEST_F(value_Marshal, VariadicArgsKeepTheLuaTypes)
+{
+    script["count_strings"].assign([](luabz::variadic_args args) {
+        int count = 0;
+        for (std::size_t i = 0; i < args.size(); ++i) {
+            count += args[i].type() == LUA_TSTRING ? 1 : 0;
+        }
+        return count;
+    });
+    script("strings = count_strings('a', 1, 'b', true, nil)");
+    ASSERT_EQ(2, static_cast<int>(script["strings"]));
+}
+TEST_F(value_Marshal, MissingFixedArgumentsSkipTheCall)
+{
+    bool called = false;
+    script["needs_two"].assign([&called](int, int, luabz::variadic_args) { called = true; });
+    script("needs_two(1)");
+    ASSERT_FALSE(called);
+}
+struct counter {
+    int total = 0;
+    void add(int value) { total += value; }
+};
+TEST_F(value_Marshal, VoidMemberFunction)
+{
+    counter c;
+    script["add"].assign(&c, &counter::add);
+    script("add(2) add(3)");
+    ASSERT_EQ(5, c.total);
+}
+TEST_F(value_Marshal, CStringIsPassedToLua)
+{
+    auto result = script["single_return"].call<std::string>("passed");
+    ASSERT_EQ("passed", std::get<0>(result));
+}
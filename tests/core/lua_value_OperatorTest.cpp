@@ -259,4 +259,26 @@ TEST_F(value_Operator, OperatorLessThanBetweenLuaValueAndConstString)
 {
     const std::string expected = "Zhis is some string";
     ASSERT_TRUE(script["string_var"] < expected);
-}
\ No newline at end of file
+}
+TEST_F(value_Operator, CompoundAssignmentOnGlobalVariable)
+{
+    script["integer_var"] += 10;
+    script["integer_var"] -= 4;
+    script["integer_var"] *= 3;
+    script["integer_var"] /= 2;
+    int actual = script["integer_var"];
+    ASSERT_EQ(159, actual);
+}
+TEST_F(value_Operator, CompoundAssignmentOnNestedTableField)
+{
+    script["Position"]["x"] += 41;
+    int actual = script["Position"]["x"];
+    ASSERT_EQ(42, actual);
+}
+TEST_F(value_Operator, UpdateAppliesFunctionToCurrentValue)
+{
+    script["string_var"].update<std::string>(
+        [](const std::string& current) { return current + " updated"; });
+    std::string actual = script["string_var"];
+    ASSERT_EQ("This is some string updated", actual);
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+
+struct overload_point {
+    int x;
+    int y;
+};
+LUABZ_FIELDS(overload_point, x, y);
+
+class value_Overload : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua"), luabz::unique_state, true};
+    void TearDown() override { script.close(); }
+    std::string describe(const std::string& arguments)
+    {
+        script("described = describe(" + arguments + ")");
+        std::string result = script["described"];
+        return result;
+    }
+};
+
+TEST_F(value_Overload, DispatchOnLuaTypes)
+{
+    script["describe"].assign(luabz::overloads(
+        [](int) { return std::string("number"); },
+        [](const std::string&) { return std::string("string"); },
+        [](overload_point point) { return "point " + std::to_string(point.x + point.y); },
+        [](bool) { return std::string("boolean"); }));
+    ASSERT_EQ("number", describe("1"));
+    ASSERT_EQ("string", describe("'text'"));
+    ASSERT_EQ("point 3", describe("{x = 1, y = 2}"));
+    ASSERT_EQ("boolean", describe("true"));
+}
+TEST_F(value_Overload, DispatchOnArgumentCount)
+{
+    script["describe"].assign([]() { return std::string("none"); },
+                              [](int) { return std::string("one"); },
+                              [](int, int) { return std::string("two"); });
+    ASSERT_EQ("none", describe(""));
+    ASSERT_EQ("one", describe("1"));
+    ASSERT_EQ("two", describe("1, 2"));
+}
+TEST_F(value_Overload, FirstMatchingOverloadWins)
+{
+    script["describe"].assign([](int) { return std::string("int"); },
+                              [](double) { return std::string("double"); });
+    ASSERT_EQ("int", describe("1.5"));
+}
+TEST_F(value_Overload, StringsAreNotNumbers)
+{
+    script["describe"].assign([](int) { return std::string("number"); },
+                              [](const char*) { return std::string("string"); });
+    ASSERT_EQ("string", describe("'10'"));
+}
+TEST_F(value_Overload, VariadicOverloadTakesTheRest)
+{
+    script["describe"].assign(
+        [](int) { return std::string("one"); },
+        [](int, luabz::variadic_args rest) { return std::to_string(rest.size()) + " more"; });
+    ASSERT_EQ("one", describe("1"));
+    ASSERT_EQ("3 more", describe("1, 2, 3, 4"));
+}
+TEST_F(value_Overload, NoMatchingOverloadRaisesAnError)
+{
+    int calls = 0;
+    script["count"].assign([&calls](int) { ++calls; }, [&calls](const std::string&) { ++calls; });
+    script("ok, message = pcall(count, 1, {})");
+    ASSERT_EQ(0, calls);
+    bool ok = script["ok"];
+    ASSERT_FALSE(ok);
+    std::string message = script["message"];
+    ASSERT_NE(std::string::npos, message.find("no overload of count accepts (number, table)"));
+}
+TEST_F(value_Overload, DispatchTableCoversVariadicArities)
+{
+    script["describe"].assign(
+        [](int, int) { return std::string("two"); },
+        [](luabz::variadic_args rest) { return std::to_string(rest.size()) + " any"; });
+    ASSERT_EQ("two", describe("1, 2"));
+    ASSERT_EQ("0 any", describe(""));
+    ASSERT_EQ("2 any", describe("1, 'text'"));
+    ASSERT_EQ("20 any", describe("1, 2, 3, 4, 5, 6, 7, 8, 9, 10, "
+                                 "11, 12, 13, 14, 15, 16, 17, 18, 19, 20"));
+}
+TEST_F(value_Overload, FindReturnsTheOverloadIndex)
+{
+    auto set = luabz::overloads([](int) {}, [](const std::string&) {});
+    lua_State* state = luaL_newstate();
+    lua_pushstring(state, "text");
+    ASSERT_EQ(1u, set.find(state));
+    lua_settop(state, 0);
+    lua_pushboolean(state, 1);
+    ASSERT_EQ(set.size(), set.find(state));
+    lua_close(state);
+}
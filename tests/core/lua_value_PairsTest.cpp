@@ -0,0 +1,78 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+
+class value_Pairs : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua")};
+    void SetUp() override
+    {
+        script("sequence = {} for i = 1, 1000 do sequence[i] = i * 2 end "
+               "mixed = {name = 'text', [3] = true, ratio = 0.5} "
+               "empty = {}");
+    }
+    void TearDown() override { script.close(); }
+};
+TEST_F(value_Pairs, TraversesEveryPair)
+{
+    std::map<std::string, int> fields;
+    for (auto entry : script["Position"].pairs()) {
+        fields[entry.key.get<std::string>()] = entry.value.get<int>();
+    }
+    std::map<std::string, int> expected{{"x", 1}, {"y", 2}, {"z", 3}};
+    ASSERT_EQ(expected, fields);
+}
+TEST_F(value_Pairs, NumericKeysAreNotConvertedInPlace)
+{
+    // Reading a number key as a string must not confuse lua_next
+    int count = 0;
+    long long sum = 0;
+    for (auto entry : script["sequence"].pairs()) {
+        ASSERT_EQ(std::to_string(entry.key.get<int>()), entry.key.get<std::string>());
+        sum += entry.value.get<int>();
+        ++count;
+    }
+    ASSERT_EQ(1000, count);
+    ASSERT_EQ(1000LL * 1001, sum);
+}
+TEST_F(value_Pairs, ProxiesExposeTheLuaTypes)
+{
+    int strings = 0;
+    int numbers = 0;
+    int booleans = 0;
+    script["mixed"].for_each([&](const luabz::stack_value& key, const luabz::stack_value& value) {
+        strings += value.type() == LUA_TSTRING ? 1 : 0;
+        numbers += value.is<double>() && key.type() == LUA_TSTRING ? 1 : 0;
+        booleans += value.type() == LUA_TBOOLEAN && key.is<int>() ? 1 : 0;
+    });
+    ASSERT_EQ(1, strings);
+    ASSERT_EQ(1, numbers);
+    ASSERT_EQ(1, booleans);
+}
+TEST_F(value_Pairs, EmptyTable)
+{
+    auto range = script["empty"].pairs();
+    ASSERT_TRUE(range.begin() == range.end());
+}
+TEST_F(value_Pairs, NestedTables)
+{
+    int count = 0;
+    for (auto entry : script["TableLevelOne.TableLevelTwo"].pairs()) {
+        count += entry.key.type() == LUA_TSTRING ? 1 : 0;
+    }
+    ASSERT_EQ(2, count);
+}
+TEST_F(value_Pairs, StackIsRestoredAfterAnEarlyExit)
+{
+    for (int i = 0; i < 10000; ++i) {
+        for (auto entry : script["sequence"].pairs()) {
+            if (entry.value.get<int>() > 10) {
+                break;
+            }
+        }
+    }
+    ASSERT_EQ(100, static_cast<int>(script["integer_var"]));
+}
@@ -0,0 +1,96 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+class value_Serializer : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua")};
+    luabz::script other{construct_script_path("luascript_test.lua"), luabz::unique_state};
+    void SetUp() override
+    {
+        script("data = {name = 'text\\0with zero', count = 3, ratio = -0.5, flag = true, "
+               "list = {10, 20, 30}, nested = {deep = {value = -42}}, fn = function() end} "
+               "data.self = data "
+               "data.shared_a = data.list "
+               "data.shared_b = data.list");
+    }
+    void TearDown() override
+    {
+        other.close();
+        script.close();
+    }
+};
+TEST_F(value_Serializer, ScalarsAreCopiedBetweenStates)
+{
+    other["integer_var"] = script["double_var"];
+    double copied = other["integer_var"];
+    ASSERT_DOUBLE_EQ(102.0351, copied);
+    other["string_var"] = script["boolf_var"];
+    ASSERT_FALSE(other["string_var"]);
+}
+TEST_F(value_Serializer, TablesAreCopiedBetweenStates)
+{
+    other["copy"] = script["data"];
+    std::string name = other["copy"]["name"];
+    ASSERT_EQ(std::string("text\0with zero", 14), name);
+    ASSERT_EQ(3, static_cast<int>(other["copy"]["count"]));
+    ASSERT_DOUBLE_EQ(-0.5, static_cast<double>(other["copy"]["ratio"]));
+    ASSERT_EQ(-42, static_cast<int>(other["copy.nested.deep.value"]));
+    other("third = copy.list[3]");
+    ASSERT_EQ(30, static_cast<int>(other["third"]));
+}
+TEST_F(value_Serializer, CyclesAndSharedTablesKeepTheirShape)
+{
+    other["copy"] = script["data"];
+    other("is_cycle = copy.self == copy "
+          "is_shared = copy.shared_a == copy.shared_b and copy.shared_a == copy.list");
+    bool is_cycle = other["is_cycle"];
+    bool is_shared = other["is_shared"];
+    ASSERT_TRUE(is_cycle);
+    ASSERT_TRUE(is_shared);
+}
+TEST_F(value_Serializer, FunctionsAreSkipped)
+{
+    ASSERT_FALSE(script["data"]["fn"].is_nil());
+    other["copy"] = script["data"];
+    ASSERT_TRUE(other["copy"]["fn"].is_nil());
+}
+TEST_F(value_Serializer, SameStateAssignment)
+{
+    script["copy"] = script["data"];
+    script("is_same = copy == data");
+    bool is_same = script["is_same"];
+    ASSERT_TRUE(is_same);
+}
+TEST_F(value_Serializer, CrossStateComparison)
+{
+    other["integer_var"] = 100;
+    ASSERT_TRUE(script["integer_var"] == other["integer_var"]);
+    ASSERT_TRUE(script["integer_var"] < other["double_var"]);
+}
+TEST_F(value_Serializer, EncodeOnceDecodeMany)
+{
+    luabz::serializer buffer;
+    script["data"]["list"].encode(buffer);
+    other["first"].decode(buffer);
+    other["second"].decode(buffer);
+    other("same = first == second total = first[1] + second[2]");
+    ASSERT_FALSE(other["same"]);
+    ASSERT_EQ(30, static_cast<int>(other["total"]));
+}
+TEST_F(value_Serializer, MalformedBufferIsRejected)
+{
+    luabz::serializer buffer;
+    script["data"].encode(buffer);
+    luabz::serializer truncated;
+    truncated.assign(buffer.buffer().data(), buffer.buffer().size() / 2);
+    other["first"] = 5;
+#ifdef LUABZ_USE_CPP_EXCEPTIONS
+    ASSERT_THROW(other["first"].decode(truncated), luabz::luabz_exception);
+#else
+    other["first"].decode(truncated);
+#endif
+    ASSERT_EQ(5, static_cast<int>(other["first"]));
+}
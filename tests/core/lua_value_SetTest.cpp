@@ -1,6 +1,7 @@
 #include "lua_test_helpers.hpp"
 #include "luabz.hpp"
 #include <gtest/gtest.h>
+#include <limits>
 #include <string>
 
 class value_Set : public ::testing::Test
@@ -97,4 +98,35 @@ TEST_F(value_Set, AssignNilToLuaVariable)
 {
     script["double_var"] = nullptr;
     ASSERT_TRUE(script["double_var"].is_nil());
-}
\ No newline at end of file
+}
+#ifdef LUABZ_LUA_NATIVE_INTEGERS
+TEST_F(value_Set, LuaVarFromCppLongLongAbove2Pow53)
+{
+    long long expected = (1LL << 53) + 1;
+    script["integer_var"] = expected;
+    long long actual = script["integer_var"];
+    ASSERT_EQ(expected, actual);
+}
+TEST_F(value_Set, LuaVarFromCppLongLongLimits)
+{
+    script["integer_var"] = std::numeric_limits<long long>::max();
+    long long actual_max = script["integer_var"];
+    ASSERT_EQ(std::numeric_limits<long long>::max(), actual_max);
+    script["integer_var"] = std::numeric_limits<long long>::min();
+    long long actual_min = script["integer_var"];
+    ASSERT_EQ(std::numeric_limits<long long>::min(), actual_min);
+}
+TEST_F(value_Set, LuaVarFromCppUnsignedLongLongMax)
+{
+    script["integer_var"] = std::numeric_limits<unsigned long long>::max();
+    unsigned long long actual = script["integer_var"];
+    ASSERT_EQ(std::numeric_limits<unsigned long long>::max(), actual);
+}
+TEST_F(value_Set, LargeIntegerIsAnIntegerInLua)
+{
+    script["integer_var"] = (1LL << 62) + 1;
+    script("integer_var = integer_var - (1 << 62)");
+    long long actual = script["integer_var"];
+    ASSERT_EQ(1, actual);
+}
+#endif
@@ -0,0 +1,103 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class value_Snapshot : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua")};
+    void SetUp() override
+    {
+        script("config = {name = 'service', limit = 100, ratio = 0.25, enabled = true, "
+               "db = {host = 'localhost', port = 5432}, servers = {'a', 'b'}, "
+               "handler = function() end} "
+               "config.self = config");
+    }
+    void TearDown() override { script.close(); }
+};
+TEST_F(value_Snapshot, ScalarsAreCopied)
+{
+    auto config = script["config"].take_snapshot();
+    ASSERT_EQ("service", config->get<std::string>("name", ""));
+    ASSERT_EQ(100, config->get<int>("limit", 0));
+    ASSERT_DOUBLE_EQ(0.25, config->get<double>("ratio", 0.0));
+    ASSERT_TRUE(config->get<bool>("enabled", false));
+}
+TEST_F(value_Snapshot, NestedTablesAreFlattened)
+{
+    auto config = script["config"].take_snapshot();
+    ASSERT_EQ("localhost", config->get<std::string>("db.host", ""));
+    ASSERT_EQ(5432, config->get<int>("db.port", 0));
+    ASSERT_EQ("a", config->get<std::string>("servers[1]", ""));
+    ASSERT_EQ("b", config->get<std::string>("servers[2]", ""));
+}
+TEST_F(value_Snapshot, DottedKeysDontCollideWithNestedTables)
+{
+    script("dotted = {['a.b'] = 'key', a = {b = 'nested'}, ['c\\\\'] = 'slash'}");
+    auto dotted = script["dotted"].take_snapshot();
+    ASSERT_EQ(3U, dotted->size());
+    ASSERT_EQ("nested", dotted->get<std::string>("a.b", ""));
+    ASSERT_EQ("key", dotted->get<std::string>(luabz::snapshot::escape_key("a.b"), ""));
+    ASSERT_EQ("key", dotted->get<std::string>("a\\.b", ""));
+    ASSERT_EQ("slash", dotted->get<std::string>(luabz::snapshot::escape_key("c\\"), ""));
+}
+TEST_F(value_Snapshot, NumericKeysDontCollideWithStringKeys)
+{
+    script("keys = {[1] = 'number', ['1'] = 'string', ['[1]'] = 'bracket', [1.5] = 'float', "
+           "[1e300] = 'huge'}");
+    auto keys = script["keys"].take_snapshot();
+    ASSERT_EQ(5U, keys->size());
+    ASSERT_EQ("number", keys->get<std::string>("[1]", ""));
+    ASSERT_EQ("string", keys->get<std::string>("1", ""));
+    ASSERT_EQ("bracket", keys->get<std::string>(luabz::snapshot::escape_key("[1]"), ""));
+    ASSERT_EQ("float", keys->get<std::string>("[1.5]", ""));
+    ASSERT_EQ("huge", keys->get<std::string>("[1e+300]", ""));
+}
+TEST_F(value_Snapshot, MissingPathsAndMismatchesReturnTheDefault)
+{
+    auto config = script["config"].take_snapshot();
+    ASSERT_FALSE(config->contains("missing"));
+    ASSERT_FALSE(config->contains("handler"));
+    ASSERT_EQ(7, config->get<int>("name", 7));
+    ASSERT_EQ("none", config->get<std::string>("limit", "none"));
+}
+TEST_F(value_Snapshot, CyclesAreNotFollowed)
+{
+    auto config = script["config"].take_snapshot();
+    ASSERT_EQ(8U, config->size());
+}
+TEST_F(value_Snapshot, SnapshotIsNotAffectedByLaterChanges)
+{
+    auto config = script["config"].take_snapshot();
+    script["config"]["limit"] = 200;
+    ASSERT_EQ(100, config->get<int>("limit", 0));
+    ASSERT_EQ(200, script["config"].take_snapshot()->get<int>("limit", 0));
+}
+TEST_F(value_Snapshot, ReadersSeePublishedSnapshots)
+{
+    luabz::snapshot_publisher publisher{script["config"].take_snapshot()};
+    std::vector<std::thread> readers;
+    std::vector<int> first_seen(4, 0);
+    for (std::size_t i = 0; i < first_seen.size(); ++i) {
+        readers.emplace_back([&publisher, &first_seen, i]() {
+            luabz::snapshot_reader reader{publisher};
+            first_seen[i] = reader.get().get<int>("limit", 0);
+            while (reader.get().get<int>("limit", 0) != 110) {
+                std::this_thread::yield();
+            }
+        });
+    }
+    for (int limit = 101; limit <= 110; ++limit) {
+        script["config"]["limit"] = limit;
+        publisher.publish(script["config"].take_snapshot());
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    for (int seen : first_seen) {
+        ASSERT_GE(seen, 100);
+    }
+}
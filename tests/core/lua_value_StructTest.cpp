@@ -0,0 +1,59 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <tuple>
+
+struct Position {
+    int x;
+    int y;
+    int z;
+};
+LUABZ_FIELDS(Position, x, y, z);
+
+struct Named {
+    std::string name;
+    double weight;
+    bool enabled;
+};
+LUABZ_FIELDS(Named, name, weight, enabled);
+
+class value_Struct : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua")};
+    void TearDown() override { script.close(); }
+};
+TEST_F(value_Struct, LuaTableAsCppAggregate)
+{
+    Position position = script["Position"];
+    ASSERT_EQ(1, position.x);
+    ASSERT_EQ(2, position.y);
+    ASSERT_EQ(3, position.z);
+}
+TEST_F(value_Struct, LuaVarFromCppAggregate)
+{
+    script["Position"] = Position{4, 5, 6};
+    int x = script["Position"]["x"];
+    int y = script["Position"]["y"];
+    int z = script["Position"]["z"];
+    ASSERT_EQ(4, x);
+    ASSERT_EQ(5, y);
+    ASSERT_EQ(6, z);
+}
+TEST_F(value_Struct, AggregateWithMixedFieldTypesRoundTrip)
+{
+    Named expected{"first", 10.5, true};
+    script["named"] = expected;
+    Named actual = script["named"];
+    ASSERT_EQ(expected.name, actual.name);
+    ASSERT_DOUBLE_EQ(expected.weight, actual.weight);
+    ASSERT_EQ(expected.enabled, actual.enabled);
+}
+TEST_F(value_Struct, AggregateAsLuaFunctionArgumentAndResult)
+{
+    auto result = script["single_return"].call<Position>(Position{7, 8, 9});
+    ASSERT_EQ(7, std::get<0>(result).x);
+    ASSERT_EQ(8, std::get<0>(result).y);
+    ASSERT_EQ(9, std::get<0>(result).z);
+}
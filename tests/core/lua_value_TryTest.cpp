@@ -0,0 +1,127 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <tuple>
+
+class value_Try : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua")};
+    void SetUp() override
+    {
+        script("function fail() error('custom failure') end "
+               "function spin() while true do end end");
+    }
+    void TearDown() override { script.close(); }
+};
+TEST_F(value_Try, TryGetReturnsTheValue)
+{
+    auto result = script["integer_var"].try_get<int>();
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(100, *result);
+}
+TEST_F(value_Try, TryGetNestedField)
+{
+    auto result = script["TableLevelOne"]["TableLevelTwo"]["x"].try_get<bool>();
+    ASSERT_TRUE(result.has_value());
+    ASSERT_TRUE(result.value());
+}
+TEST_F(value_Try, TryGetTypeMismatch)
+{
+    auto result = script["Position"].try_get<int>();
+    ASSERT_FALSE(result.has_value());
+    ASSERT_EQ(luabz::error_kind::type_mismatch, result.error().kind());
+    ASSERT_EQ("Position", result.error().variable_name());
+}
+TEST_F(value_Try, TryGetParentIsNotATable)
+{
+    auto result = script["Position.x.y"].try_get<int>();
+    ASSERT_FALSE(result.has_value());
+    ASSERT_EQ(luabz::error_kind::not_a_table, result.error().kind());
+}
+TEST_F(value_Try, TryGetValueOr)
+{
+    ASSERT_EQ(7, script["string_var"].try_get<int>().value_or(7));
+}
+TEST_F(value_Try, AssignmentSwitchesBetweenValueAndError)
+{
+    auto result = script["string_var"].try_get<std::string>();
+    result = script["Position"].try_get<std::string>();
+    ASSERT_FALSE(result.has_value());
+    result = script["string_var"].try_get<std::string>();
+    ASSERT_TRUE(result.has_value());
+    auto copy = script["Position"].try_get<std::string>();
+    copy = result;
+    ASSERT_EQ(*result, *copy);
+}
+#ifndef LUABZ_USE_CPP_EXCEPTIONS
+TEST_F(value_Try, ValueOfAnErrorTerminates)
+{
+    auto result = script["Position"].try_get<int>();
+    ASSERT_DEATH(static_cast<void>(result.value()), "");
+}
+#endif
+TEST_F(value_Try, TryCallReturnsTheResults)
+{
+    auto result = script["multiple_returns"].try_call<int, std::string>(1, std::string{"two"});
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(1, std::get<0>(*result));
+    ASSERT_EQ("two", std::get<1>(*result));
+}
+TEST_F(value_Try, TryCallRuntimeError)
+{
+    auto result = script["fail"].try_call<>();
+    ASSERT_FALSE(result.has_value());
+    ASSERT_EQ(luabz::error_kind::runtime, result.error().kind());
+    ASSERT_NE(std::string::npos, result.error().lua_message().find("custom failure"));
+    ASSERT_NE(std::string::npos, result.error().message().find("fail"));
+}
+TEST_F(value_Try, TryCallNotAFunction)
+{
+    auto result = script["integer_var"].try_call<int>();
+    ASSERT_FALSE(result.has_value());
+    ASSERT_EQ(luabz::error_kind::not_a_function, result.error().kind());
+}
+TEST_F(value_Try, TryCallResultTypeMismatch)
+{
+    auto result = script["single_return"].try_call<int>(std::string{"text"});
+    ASSERT_FALSE(result.has_value());
+    ASSERT_EQ(luabz::error_kind::type_mismatch, result.error().kind());
+}
+TEST_F(value_Try, TryCallBudgetExceeded)
+{
+    auto result = script["spin"].try_call<>(luabz::budget::instructions_limit(10000));
+    ASSERT_FALSE(result.has_value());
+    ASSERT_EQ(luabz::error_kind::budget_exceeded, result.error().kind());
+}
+TEST_F(value_Try, StackIsBalancedOnEveryPath)
+{
+    // A leaked stack slot per iteration would overflow the lua stack
+    for (int i = 0; i < 10000; ++i) {
+        script["fail"].try_call<>();
+        script["integer_var"].try_call<int>();
+        script["single_return"].try_call<int>(std::string{"text"});
+        script["multiple_returns"].try_call<>(1, 2);
+        script["Position"].try_get<int>();
+        script["Position.x.y"].try_get<int>();
+    }
+    auto result = script["single_return"].try_call<int>(3);
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(3, std::get<0>(*result));
+}
+#ifndef LUABZ_USE_CPP_EXCEPTIONS
+TEST_F(value_Try, InvalidPathLeavesTheStateUntouched)
+{
+    lua_State* state = luabz::state::get(construct_script_path("luascript_test.lua"));
+    int top = lua_gettop(state);
+    script["integer_var.x"] = 5;
+    script["integer_var.x"] += 1;
+    int value = script["integer_var.x"];
+    ASSERT_EQ(top, lua_gettop(state));
+    ASSERT_EQ(0, value);
+    ASSERT_EQ(100, static_cast<int>(script["integer_var"]));
+    ASSERT_TRUE(script["x"].is_nil());
+    ASSERT_TRUE(script["integer_var.x"].is_nil());
+}
+#endif
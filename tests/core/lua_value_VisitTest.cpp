@@ -0,0 +1,125 @@
+#include "lua_test_helpers.hpp"
+#include "luabz.hpp"
+#include <cstddef>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+/// Records the events as a compact string, keys and scalars in lua order
+struct recording_visitor : luabz::table_visitor {
+    std::string events;
+    std::size_t max_depth = 0;
+    void begin_table(std::size_t depth)
+    {
+        events += '{';
+        max_depth = depth > max_depth ? depth : max_depth;
+    }
+    void key(const luabz::stack_value& key) { events += key.get<std::string>() + '='; }
+    void scalar(const luabz::stack_value& value)
+    {
+        switch (value.type()) {
+            case LUA_TTABLE:
+                events += "table";
+                break;
+            case LUA_TBOOLEAN:
+                events += value.get<bool>() ? "true" : "false";
+                break;
+            default:
+                events += value.get<std::string>();
+                break;
+        }
+        events += ';';
+    }
+    void end_table(std::size_t /*unused*/) { events += '}'; }
+};
+
+/// Streams rows of {id, price} into columns
+struct columns_visitor : luabz::table_visitor {
+    std::vector<int> ids;
+    std::vector<double> prices;
+    std::string current_key;
+    void key(const luabz::stack_value& key)
+    {
+        if (key.type() == LUA_TSTRING) {
+            current_key = key.get<std::string>();
+        }
+    }
+    void scalar(const luabz::stack_value& value)
+    {
+        if (current_key == "id") {
+            ids.push_back(value.get<int>());
+        } else if (current_key == "price") {
+            prices.push_back(value.get<double>());
+        }
+    }
+};
+}  // namespace
+
+class value_Visit : public ::testing::Test
+{
+  public:
+    luabz::script script{construct_script_path("luascript_test.lua")};
+    void SetUp() override
+    {
+        script("rows = {} for i = 1, 1000 do rows[i] = {id = i, price = i / 2} end "
+               "single = {inner = {1}} "
+               "cyclic = {child = {}} cyclic.child.parent = cyclic");
+    }
+    void TearDown() override { script.close(); }
+};
+TEST_F(value_Visit, EventsFollowTheNesting)
+{
+    recording_visitor visitor;
+    script["single"].visit(visitor);
+    ASSERT_EQ("{inner={1=1;}}", visitor.events);
+    ASSERT_EQ(1U, visitor.max_depth);
+}
+TEST_F(value_Visit, StreamsRowsIntoColumns)
+{
+    columns_visitor visitor;
+    script["rows"].visit(visitor);
+    ASSERT_EQ(1000U, visitor.ids.size());
+    ASSERT_EQ(1000U, visitor.prices.size());
+    long long sum = 0;
+    for (int id : visitor.ids) {
+        sum += id;
+    }
+    ASSERT_EQ(500500, sum);
+}
+TEST_F(value_Visit, CyclesAreReportedAsScalars)
+{
+    recording_visitor visitor;
+    script["cyclic"].visit(visitor);
+    ASSERT_EQ("{child={parent=table;}}", visitor.events);
+}
+TEST_F(value_Visit, DepthIsBounded)
+{
+    recording_visitor visitor;
+    script["TableLevelOne"].visit(visitor, 3);
+    ASSERT_EQ(2U, visitor.max_depth);
+    ASSERT_NE(std::string::npos, visitor.events.find("TableLevelFour=table;"));
+}
+TEST_F(value_Visit, StackIsRestored)
+{
+    for (int i = 0; i < 1000; ++i) {
+        luabz::table_visitor ignoring;
+        script["TableLevelOne"].visit(ignoring);
+    }
+    ASSERT_EQ(100, static_cast<int>(script["integer_var"]));
+}
+TEST_F(value_Visit, TablesBelowTheTopOfTheStackCanBeWalked)
+{
+    lua_State* state = luabz::state::get(construct_script_path("luascript_test.lua"));
+    int top = lua_gettop(state);
+    lua_getglobal(state, "single");
+    lua_pushinteger(state, 1);
+    lua_pushinteger(state, 2);
+    recording_visitor visitor;
+    luabz::table_walker<recording_visitor> walker{state, visitor, 64};
+    walker.walk(-3);
+    ASSERT_EQ("{inner={1=1;}}", visitor.events);
+    ASSERT_EQ(top + 3, lua_gettop(state));
+    lua_settop(state, top);
+}
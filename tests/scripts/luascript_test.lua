@@ -48,4 +48,12 @@ TableLevelOne={
             }
         }
     }
-}
\ No newline at end of file
+}
+
+function busy_loop(n)
+    local total=0;
+    for i=1,n do
+        total=total+i%7;
+    end
+    return total;
+end